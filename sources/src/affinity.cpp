@@ -0,0 +1,164 @@
+/*
+Rodent, a UCI chess playing engine derived from Sungorus 1.4
+Copyright (C) 2009-2011 Pablo Vazquez (Sungorus author)
+Copyright (C) 2011-2019 Pawel Koziol
+Copyright (C) 2020-2020 Bernhard C. Maerz
+
+Rodent is free software: you can redistribute it and/or modify it under the terms of the GNU
+General Public License as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+Rodent is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with this program.
+If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Placement of the search threads. With "ThreadAffinity" every engine's
+// worker is bound to one logical cpu, so that the scheduler can neither
+// move it around nor put two engines on one core while other cores idle.
+
+#include "rodent.h"
+#include <cstdio>
+
+#ifdef USE_THREADS
+
+#include <algorithm>
+#include <vector>
+
+#if defined(__linux__) && !defined(ANDROID)
+    #define PIN_THREADS
+    #include <pthread.h>
+    #include <sched.h>
+#endif
+
+// The Threads option goes as far as the machine has logical cpus, but
+// never below the old fixed limit, so that smaller machines can still be
+// oversubscribed for testing.
+
+int MaxThreads() {
+
+    static const int limit = Max(MAX_THREADS_FLOOR, (int)std::thread::hardware_concurrency());
+    return limit;
+}
+
+#ifdef PIN_THREADS
+
+struct sCpu {
+    int id;         // as numbered by the kernel
+    int package;    // socket
+    int core;       // physical core within the package
+    int sibling;    // 0 for the first logical cpu of its core, 1 for its first SMT sibling...
+};
+
+static int ReadTopology(int cpu, const char *name) {
+
+    char path[128];
+    int value = -1;
+
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/%s", cpu, name);
+    FILE *file = fopen(path, "r");
+    if (file) {
+        if (fscanf(file, "%d", &value) != 1) value = -1;
+        fclose(file);
+    }
+
+    return value;
+}
+
+// The cpus the process may run on, in the order engines get them: the first
+// logical cpu of every physical core comes before any SMT sibling, so engines
+// share a core only when there are more of them than cores. Cores of one
+// package come before the next package, which keeps a small search on one
+// socket and its cache. Without topology every cpu counts as its own core.
+
+static std::vector<sCpu> ReadCpus() {
+
+    std::vector<sCpu> cpus;
+    cpu_set_t allowed;
+
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+        return cpus;
+
+    for (int id = 0; id < CPU_SETSIZE; id++) {
+        if (!CPU_ISSET(id, &allowed)) continue;
+
+        sCpu cpu;
+        cpu.id = id;
+        cpu.package = ReadTopology(id, "physical_package_id");
+        cpu.core = ReadTopology(id, "core_id");
+        if (cpu.package < 0 || cpu.core < 0) {
+            cpu.package = 0;
+            cpu.core = id;
+        }
+        cpu.sibling = 0;
+        for (const sCpu &other : cpus)
+            if (other.package == cpu.package && other.core == cpu.core)
+                cpu.sibling++;
+        cpus.push_back(cpu);
+    }
+
+    std::stable_sort(cpus.begin(), cpus.end(), [](const sCpu &a, const sCpu &b) {
+        if (a.sibling != b.sibling) return a.sibling < b.sibling;
+        if (a.package != b.package) return a.package < b.package;
+        return a.core < b.core;
+    });
+
+    return cpus;
+}
+
+#endif
+
+// Binds the engines to their cpus, or releases them when "ThreadAffinity"
+// is off. Called whenever the engines are resized; `verbose` reports the
+// placement as info strings.
+
+void PlaceEngines(bool verbose) {
+
+#ifdef PIN_THREADS
+    static const std::vector<sCpu> cpus = ReadCpus();
+    static bool pinned = false;
+
+    if (cpus.empty()) {
+        if (verbose && Glob.pinThreads)
+            printfUciOut("info string ThreadAffinity: cpus of the process unknown, threads not bound\n");
+        return;
+    }
+
+    if (!Glob.pinThreads && !pinned) {
+        if (verbose)
+            printfUciOut("info string ThreadAffinity: threads not bound\n");
+        return;
+    }
+
+    cpu_set_t set;
+    int thread = 0;
+
+    for (auto& engine: Engines) {
+        CPU_ZERO(&set);
+        if (Glob.pinThreads) {
+            const sCpu &cpu = cpus[thread % cpus.size()];
+            CPU_SET(cpu.id, &set);
+            if (verbose)
+                printfUciOut("info string thread %d on cpu %d (package %d core %d%s)\n",
+                             thread, cpu.id, cpu.package, cpu.core, cpu.sibling ? " smt" : "");
+        } else {
+            for (const sCpu &cpu : cpus)
+                CPU_SET(cpu.id, &set);
+        }
+        pthread_setaffinity_np(engine.mWorker.native_handle(), sizeof(set), &set);
+        thread++;
+    }
+
+    pinned = Glob.pinThreads;
+    if (verbose && !pinned)
+        printfUciOut("info string ThreadAffinity: threads not bound\n");
+#else
+    if (verbose && Glob.pinThreads)
+        printfUciOut("info string ThreadAffinity is not supported on this system\n");
+#endif
+}
+
+#endif
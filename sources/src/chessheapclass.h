@@ -1,43 +1,120 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <cstdint>
+#include <vector>
+#if defined(_MSC_VER) && defined(_WIN64)
+    #include <intrin.h>
+#endif
 
 
+enum eTTBacking { TT_MALLOC, TT_HUGETLB, TT_THP, TT_FILE, TT_SHARED };
+
+struct TTFILEHEADER;
+
+struct TTPROBE {        // copy of the entry found by Probe()
+    bool found;
+    int move;
+    int score;          // mate scores are relative to the probing node
+    int flags;          // UPPER, LOWER or EXACT
+    int depth;
+    int age;            // searches since the entry was last used
+    int eval;           // static eval, NO_EVAL if the entry has none
+};
+
+struct TTSTATS {        // counters of one search thread, padded to keep threads off each other's cache lines
+    U64 probes;
+    U64 hits;
+    U64 cutoffs;
+    U64 badMoves;       // hash moves rejected by POS::Legal()
+    U64 stores;
+    U64 storeSame;      // rewrote the entry of the same position
+    U64 storeEmpty;     // took an unused slot
+    U64 storeOlder;     // replaced an entry of an earlier search
+    U64 storeCurrent;   // replaced an entry of this search
+    U64 evals;          // hits that supplied the static eval, so Evaluate() was skipped
+    U64 padding[6];
+};
+
 class ChessHeapClass {
-    static constexpr int bucket_size_mb = 512;
-    static constexpr int num_per_bucket = bucket_size_mb * 1024 * 1024 / sizeof(ENTRY);
+    static constexpr int bucket_size_mb = sizeof(void *) >= 8 ? 4096 : 512;
+    static constexpr U64 num_per_bucket = (U64)bucket_size_mb * 1024 * 1024 / sizeof(CLUSTER);
     static constexpr int arrays_size = max_tt_size_mb / bucket_size_mb;
 
-    static_assert(sizeof(ENTRY) == 16, "ENTRY size must be 16 bytes.");
+    static_assert(sizeof(ENTRY) == 10, "ENTRY size must be 10 bytes.");
+    static_assert(sizeof(CLUSTER) == 64, "CLUSTER size must be 64 bytes.");
 
-    int    bucket_sizs[arrays_size];
-    ENTRY *bucket_ptrs[arrays_size];
+    int      bucket_sizs[arrays_size];
+    void    *bucket_mems[arrays_size];  // as returned by malloc(), needed for free()
+    CLUSTER *bucket_ptrs[arrays_size];  // aligned to the cache line
 
-    unsigned int tt_size;
-    unsigned int tt_mask;
+    void  *huge_mem;                    // single mapped region of huge pages, a hash file or shared memory, if we got one
+    size_t huge_size;
+    TTFILEHEADER *shared;               // header of the shared memory segment, if the table is in one
+
+    U64 tt_size;                        // number of clusters, not necessarily a power of two
+    unsigned int tt_mb;                 // the same in megabytes
+    uint32_t tt_salt;                   // changed by Clear(), so that older entries stop matching
 
     bool success;
+    eTTBacking backing;
+
+    std::vector<TTSTATS> stats;         // one per engine, see SetThread()
+    static thread_local int msThread;  // which stats[] the calling thread updates
+
+    bool AllocHuge(int size_mb);
+    bool MapFile(const char *fileName, size_t fileSize);
+    void UseRegion(void *mem, size_t size, eTTBacking how);
+    void FreeHuge();
 
     void Free() {           // free the allocated memory and zeroize bucket_ptrs[]
 
+        if (huge_mem) {
+            FreeHuge();
+            shared = NULL;
+            return;
+        }
+
         for (int i = 0; i < arrays_size && bucket_ptrs[i]; i++) {
-            free(bucket_ptrs[i]);
+            free(bucket_mems[i]);
+            bucket_mems[i] = NULL;
             bucket_ptrs[i] = NULL;
         }
     }
 
-    void ZeroMem() {        // zeroize the allocated memory
+    void ZeroMem();         // zeroize the allocated memory, using all hardware threads
+    bool Resize(unsigned int mbsize);
+    U64 Rehash(const ChessHeapClass &old);
+    void Swap(ChessHeapClass &other);
 
-        if (success)
-            for (int i = 0; i < arrays_size && bucket_ptrs[i]; i++)
-                memset(bucket_ptrs[i], 0, 1024 * 1024 * bucket_sizs[i]);
+    CLUSTER *MakeAddr(U64 cluster_number) const {     // calculate address of the cluster with cluster_number
+
+        const U64 num_of_bucket = cluster_number / num_per_bucket;
+
+        return bucket_ptrs[num_of_bucket] + (cluster_number - num_per_bucket * num_of_bucket);
+    }
+
+    static U64 MulHi64(U64 a, U64 b) {          // upper half of the 128-bit product
+
+#if defined(__SIZEOF_INT128__)
+        return (U64)(((unsigned __int128)a * b) >> 64);
+#elif defined(_MSC_VER) && defined(_WIN64)
+        return __umulh(a, b);
+#else
+        const U64 aLo = (uint32_t)a, aHi = a >> 32, bLo = (uint32_t)b, bHi = b >> 32;
+        const U64 mid = aHi * bLo + (aLo * bLo >> 32);
+        return aHi * bHi + (mid >> 32) + ((aLo * bHi + (uint32_t)mid) >> 32);
+#endif
     }
 
-    ENTRY *MakeAddr(int entry_number) const {     // calculate address of the entry with entry_number
+    // Map a hash key onto [0, tt_size) with a multiply-shift, which works for
+    // any table size. The index comes from the high bits of the product, so
+    // entries are verified with the low 16 bits of the key. The key is
+    // scrambled first, because its two top bits only encode the side to move.
 
-        const int num_of_bucket = entry_number / num_per_bucket;
+    CLUSTER *Cluster(U64 key) const {
 
-        return bucket_ptrs[num_of_bucket] + entry_number - num_per_bucket * num_of_bucket;
+        return MakeAddr(MulHi64(key * UINT64_C(0x9E3779B97F4A7C15), tt_size));
     }
 
     bool Alloc(int size_mb) {       // allocate size_mb megabyte of memory and return true on success
@@ -47,15 +124,24 @@ class ChessHeapClass {
 
         Free();
 
+        // try huge pages first, then fall back to buckets allocated with malloc
+
+        success = AllocHuge(size_mb);
+        if (success)
+            return true;
+
+        backing = TT_MALLOC;
         success = true;
         for (int i = 0; size_mb > 0 && success; i++) {
             bucket_sizs[i] = size_mb > bucket_size_mb ? bucket_size_mb : size_mb;
-            bucket_ptrs[i] = (ENTRY *) malloc(1024 * 1024 * bucket_sizs[i]);
-            success = bucket_ptrs[i] != NULL;
+            bucket_mems[i] = malloc((size_t)bucket_sizs[i] * 1024 * 1024 + sizeof(CLUSTER) - 1);
+            success = bucket_mems[i] != NULL;
             size_mb -= bucket_size_mb;
 
-            if (success)
+            if (success) {
+                bucket_ptrs[i] = (CLUSTER *) (((uintptr_t)bucket_mems[i] + sizeof(CLUSTER) - 1) & ~(uintptr_t)(sizeof(CLUSTER) - 1));
                 printf_debug("allocated: %dMB\n", bucket_sizs[i]);
+            }
         }
 
         if (!success)
@@ -64,11 +150,28 @@ class ChessHeapClass {
         return success;
     }
 
+    uint16_t Lock(U64 key) const {              // what an entry of this key stores, before xor with data
+
+        return (uint16_t)((uint32_t)key ^ tt_salt);
+    }
+
+    static bool IsEmpty(const ENTRY &entry) {   // never written since the memory was zeroized
+
+        return !entry.key && !entry.move && !entry.score && !entry.eval && !entry.dateFlags && !entry.depth;
+    }
+
+    bool IsKey(const ENTRY &entry, U64 key) const {     // does the entry belong to this hash key?
+
+        return (entry.key ^ entry.Data()) == Lock(key);
+    }
+
+    void Refresh(ENTRY *entry, ENTRY snap, U64 key);
+
   public:
 
     int tt_date;
 
-    ChessHeapClass(): bucket_ptrs{}, success{false} {};
+    ChessHeapClass(): bucket_mems{}, bucket_ptrs{}, huge_mem{NULL}, huge_size{0}, shared{NULL}, tt_size{0}, tt_mb{0}, tt_salt{0}, success{false}, backing{TT_MALLOC}, stats(1) {};
 
     ~ChessHeapClass() {
 
@@ -76,8 +179,32 @@ class ChessHeapClass {
     }
 
     void AllocTrans(unsigned int mbsize);
+    void PrintBacking() const;
     void Clear();
+    void Reset();
+    void NewSearch();
+    bool Probe(U64 key, int ply, TTPROBE *hit);
     bool Retrieve(U64 key, int *move, int *score, int *flag, int alpha, int beta, int depth, int ply);
     void RetrieveMove(U64 key, int *move);
-    void Store(U64 key, int move, int score, int flags, int depth, int ply);
+    void Store(U64 key, int move, int score, int flags, int depth, int ply, int eval);
+    void Prefetch(U64 key) const { ::Prefetch(Cluster(key)); }
+    void Bench(int millions);
+    bool Save(const char *fileName);
+    bool Load(const char *fileName);
+    bool Share(const char *name);
+    void Unshare();
+
+    static void SetThread(int thread) { msThread = thread; }
+    void SetThreads(int count) { stats.assign(count, TTSTATS()); }    // only between searches
+    void CountBadMove() { stats[msThread].badMoves++; }
+    void CountEval() { stats[msThread].evals++; }
+    void CountCutoff() { stats[msThread].cutoffs++; }    // a node returned the hash score
+
+    bool Cutoff(const TTPROBE &hit, int alpha, int beta, int depth) const {    // does the entry cut this node at this depth?
+
+        return hit.found && hit.depth >= depth
+            && ((hit.flags & UPPER && hit.score <= alpha) || (hit.flags & LOWER && hit.score >= beta));
+    }
+    int HashFull() const;
+    void PrintStats() const;
 };
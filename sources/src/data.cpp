@@ -53,7 +53,7 @@ U64 POS::CastleMask_B_KS;
 U64 POS::CastleMask_B_QS;
 
 #ifndef NO_THREADS
-    int tDepth[MAX_THREADS];
+    std::vector<int> tDepth(1);
 #endif
 int cEngine::msMoveTime;
 int cEngine::msMoveNodes;
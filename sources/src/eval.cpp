@@ -24,21 +24,26 @@ If not, see <http://www.gnu.org/licenses/>.
 
 //#define DEBUG_EVAL_HASH
 
+cSharedEvalCache SharedEval;
+
 int cEngine::Evaluate(POS *p, eData *e) {
 
-    // Try retrieving score from per-thread eval hashtable
+    // Try retrieving score from the shared or the per-thread eval hashtable
 
-    int addr = p->mHashKey % EVAL_HASH_SIZE;
+    const bool shared = SharedEval.Active();
+    sEvalHashEntry *entry = mEvalTT.Entry(p->mHashKey);
 #ifdef DEBUG_EVAL_HASH
     bool isHashEntry = false;
 #endif
     int hashScore = 0;
 
-    if (mEvalTT[addr].key == p->mHashKey) {
+    mEvalTT.probes++;
+    if (shared ? SharedEval.Probe(p->mHashKey, &hashScore) : mEvalTT.Match(entry, p->mHashKey)) {
+        mEvalTT.hits++;
 #ifdef DEBUG_EVAL_HASH
         isHashEntry = true;
 #endif
-        hashScore = mEvalTT[addr].score;
+        if (!shared) hashScore = entry->score;
 #ifndef DEBUG_EVAL_HASH
         return p->mSide == WC ? hashScore : -hashScore;
 #endif
@@ -217,8 +222,12 @@ int cEngine::Evaluate(POS *p, eData *e) {
         printf("x");
 #endif
 
-    mEvalTT[addr].key = p->mHashKey;
-    mEvalTT[addr].score = score;
+    if (shared)
+        SharedEval.Store(p->mHashKey, score);
+    else {
+        mEvalTT.SetKey(entry, p->mHashKey);
+        entry->score = score;
+    }
 
     // Return score relative to the side to move
 
@@ -233,9 +242,72 @@ void cEngine::ClearAll() {
     ClearHist();
 }
 
+// Sizes come from the "EvalCacheKB" and "PawnCacheKB" options; the
+// engines built before Glob.Init() get the defaults
+
+void cEngine::ResizeCaches() {
+
+    if (!mEvalTT.Resize(Glob.evalCacheKb ? Glob.evalCacheKb : EVAL_CACHE_KB))
+        printfUciOut("info string thread %d: eval cache not resized, out of memory\n", mcThreadId);
+    if (!mPawnTT.Resize(Glob.pawnCacheKb ? Glob.pawnCacheKb : PAWN_CACHE_KB))
+        printfUciOut("info string thread %d: pawn cache not resized, out of memory\n", mcThreadId);
+}
+
+void cEngine::ResizeAllCaches() {
+
+    if (Glob.shareEvalCache) {
+        if (!SharedEval.Resize(Glob.evalCacheKb))
+            printfUciOut("info string shared eval cache out of memory, threads use their own\n");
+    } else {
+        SharedEval.Free();
+    }
+
+#ifdef USE_THREADS
+    for (auto& engine: Engines)
+        engine.ResizeCaches();
+#else
+    EngineSingle.ResizeCaches();
+#endif
+}
+
+// Console command "cachestats": hit rates of the eval and pawn caches since
+// they were last cleared (ucinewgame or bench), summed over all engines
+
+void cEngine::PrintCacheStats() {
+
+    U64 evalProbes = 0, evalHits = 0, pawnProbes = 0, pawnHits = 0;
+    int evalKb = 0, pawnKb = 0;
+
+    auto add = [&](const cEngine &engine) {
+        evalProbes += engine.mEvalTT.probes;
+        evalHits += engine.mEvalTT.hits;
+        pawnProbes += engine.mPawnTT.probes;
+        pawnHits += engine.mPawnTT.hits;
+        evalKb = engine.mEvalTT.Kilobytes();
+        pawnKb = engine.mPawnTT.Kilobytes();
+    };
+
+#ifdef USE_THREADS
+    for (auto& engine: Engines)
+        add(engine);
+#else
+    add(EngineSingle);
+#endif
+
+    if (SharedEval.Active())
+        printf("eval cache %d KB shared: %" PRIu64 " probes, %" PRIu64 " hits (%.1f%%)\n",
+               SharedEval.Kilobytes(), evalProbes, evalHits, evalProbes ? 100.0 * evalHits / evalProbes : 0.0);
+    else
+        printf("eval cache %d KB per engine: %" PRIu64 " probes, %" PRIu64 " hits (%.1f%%)\n",
+               evalKb, evalProbes, evalHits, evalProbes ? 100.0 * evalHits / evalProbes : 0.0);
+    printf("pawn cache %d KB per engine: %" PRIu64 " probes, %" PRIu64 " hits (%.1f%%)\n",
+           pawnKb, pawnProbes, pawnHits, pawnProbes ? 100.0 * pawnHits / pawnProbes : 0.0);
+}
+
 void cEngine::ClearEvalHash() {
 
-    ZEROARRAY(mEvalTT);
+    mEvalTT.Clear();
+    SharedEval.Clear();
 }
 
 void cEngine::EvaluateMaterial(POS *p, eData *e, eColor sd) {
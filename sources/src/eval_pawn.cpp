@@ -22,23 +22,25 @@ If not, see <http://www.gnu.org/licenses/>.
 
 void cEngine::ClearPawnHash() {
 
-    ZEROARRAY(mPawnTT);
+    mPawnTT.Clear();
 }
 
 void cEngine::EvaluatePawnStruct(POS *p, eData *e) {
 
     // Try to retrieve score from pawn hashtable
 
-    int addr = p->mPawnKey % PAWN_HASH_SIZE;
+    sPawnHashEntry *entry = mPawnTT.Entry(p->mPawnKey);
 
-    if (mPawnTT[addr].key == p->mPawnKey) {
+    mPawnTT.probes++;
+    if (mPawnTT.Match(entry, p->mPawnKey)) {
+        mPawnTT.hits++;
 
         // pawn hashtable contains delta of white and black score
 
-        e->mgPawns[WC] = mPawnTT[addr].mg_white_pawns;
-        e->egPawns[WC] = mPawnTT[addr].eg_white_pawns;
-        e->mgPawns[BC] = mPawnTT[addr].mg_black_pawns;
-        e->egPawns[BC] = mPawnTT[addr].eg_black_pawns;
+        e->mgPawns[WC] = entry->mg_white_pawns;
+        e->egPawns[WC] = entry->eg_white_pawns;
+        e->mgPawns[BC] = entry->mg_black_pawns;
+        e->egPawns[BC] = entry->eg_black_pawns;
         return;
     }
 
@@ -127,11 +129,11 @@ void cEngine::EvaluatePawnStruct(POS *p, eData *e) {
     // Note that we save delta between white and black scores.
     // It might become a problem if we decide to print detailed eval score.
 
-    mPawnTT[addr].key = p->mPawnKey;
-    mPawnTT[addr].mg_white_pawns = e->mgPawns[WC];
-    mPawnTT[addr].mg_black_pawns = e->mgPawns[BC];
-    mPawnTT[addr].eg_white_pawns = e->egPawns[WC];
-    mPawnTT[addr].eg_black_pawns = e->egPawns[BC];
+    mPawnTT.SetKey(entry, p->mPawnKey);
+    entry->mg_white_pawns = e->mgPawns[WC];
+    entry->mg_black_pawns = e->mgPawns[BC];
+    entry->eg_white_pawns = e->egPawns[WC];
+    entry->eg_black_pawns = e->egPawns[BC];
 
 }
 
@@ -0,0 +1,170 @@
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <new>
+
+// Cache of evaluation results kept by every engine: sEvalHashEntry for
+// Evaluate() and sPawnHashEntry for EvaluatePawnStruct(). The table lives
+// on the heap, aligned to the cache line, with a power of two entries that
+// fits in the size given in kilobytes ("EvalCacheKB", "PawnCacheKB").
+//
+// Clear() leaves the memory alone. Stored keys are xor-ed with a tag taken
+// from the generation of the table, so bumping the generation makes all
+// older entries miss, which is what zeroing the table used to do.
+
+template<typename T>
+class cEvalCache {
+    T *mTable;
+    void *mMem;             // as returned by malloc(), needed for free()
+    U64 mMask;
+    U64 mTag;
+    U64 mGeneration;
+    T mSpare;               // one-entry table if nothing could be allocated
+
+  public:
+    U64 probes;             // since the last Clear()
+    U64 hits;
+
+    cEvalCache(): mTable(NULL), mMem(NULL), mMask(0), mTag(0), mGeneration(0), mSpare(), probes(0), hits(0) {}
+    cEvalCache(const cEvalCache&) = delete;
+    cEvalCache& operator=(const cEvalCache&) = delete;
+    ~cEvalCache() { free(mMem); }
+
+    // Returns false if not even the smallest table could be allocated. The
+    // old table is then kept, so that Entry() always has somewhere to point.
+
+    bool Resize(int kb) {
+
+        U64 entries = 1;
+        while (entries * 2 * sizeof(T) <= (U64)kb * 1024)
+            entries *= 2;
+
+        if (mTable && entries == mMask + 1) {
+            Clear();
+            return true;
+        }
+
+        void *mem = NULL;
+        for (; entries; entries /= 2) {
+            mem = malloc(entries * sizeof(T) + 63);
+            if (mem) break;
+        }
+
+        if (!mem) {
+            if (!mTable) {
+                mTable = &mSpare;
+                mMask = 0;
+            }
+            Clear();
+            return false;
+        }
+
+        free(mMem);
+        mMem = mem;
+        mTable = (T *)(((uintptr_t)mMem + 63) & ~(uintptr_t)63);
+        memset(mTable, 0, entries * sizeof(T));
+        mMask = entries - 1;
+        Clear();
+        return true;
+    }
+
+    void Clear() {
+
+        mTag = ++mGeneration * UINT64_C(0x9E3779B97F4A7C15);
+        probes = 0;
+        hits = 0;
+    }
+
+    int Kilobytes() const { return (int)((mMask + 1) * sizeof(T) / 1024); }
+
+    T *Entry(U64 key) const { return &mTable[key & mMask]; }
+    bool Match(const T *entry, U64 key) const { return entry->key == (key ^ mTag); }
+    void SetKey(T *entry, U64 key) const { entry->key = key ^ mTag; }
+};
+
+// Optional eval cache shared by all engines ("EvalCacheShared"), so that a
+// position evaluated by one thread is not evaluated again by the others.
+// An entry is one 64-bit word: the upper 48 bits of the tagged key with the
+// score in the lower 16, so a store or a load is a single relaxed atomic
+// access and a torn entry cannot exist. While it is off, every engine uses
+// its own cEvalCache.
+
+class cSharedEvalCache {
+    std::atomic<U64> *mTable;
+    void *mMem;
+    U64 mMask;
+    U64 mTag;
+    U64 mGeneration;
+
+    static constexpr U64 scoreBits = 0xFFFF;
+
+  public:
+    constexpr cSharedEvalCache(): mTable(NULL), mMem(NULL), mMask(0), mTag(0), mGeneration(0) {}
+    cSharedEvalCache(const cSharedEvalCache&) = delete;
+    cSharedEvalCache& operator=(const cSharedEvalCache&) = delete;
+    ~cSharedEvalCache() { Free(); }
+
+    bool Active() const { return mTable != NULL; }
+
+    void Free() {
+
+        free(mMem);
+        mMem = NULL;
+        mTable = NULL;
+        mMask = 0;
+    }
+
+    // Only between searches; returns false if nothing could be allocated
+
+    bool Resize(int kb) {
+
+        U64 entries = 1;
+        while (entries * 2 * sizeof(U64) <= (U64)kb * 1024)
+            entries *= 2;
+
+        if (mTable && entries == mMask + 1) {
+            Clear();
+            return true;
+        }
+
+        Free();
+
+        for (; entries; entries /= 2) {
+            mMem = malloc(entries * sizeof(U64) + 63);
+            if (mMem) break;
+        }
+
+        if (!mMem) return false;
+
+        mTable = (std::atomic<U64> *)(((uintptr_t)mMem + 63) & ~(uintptr_t)63);
+        for (U64 i = 0; i < entries; i++)
+            new (&mTable[i]) std::atomic<U64>(0);
+        mMask = entries - 1;
+        Clear();
+        return true;
+    }
+
+    void Clear() { mTag = ++mGeneration * UINT64_C(0x9E3779B97F4A7C15); }
+
+    int Kilobytes() const { return mTable ? (int)((mMask + 1) * sizeof(U64) / 1024) : 0; }
+
+    const void *Entry(U64 key) const { return &mTable[key & mMask]; }
+
+    bool Probe(U64 key, int *score) const {
+
+        const U64 word = mTable[key & mMask].load(std::memory_order_relaxed);
+
+        if ((word ^ key ^ mTag) & ~scoreBits)
+            return false;
+
+        *score = (int16_t)(word & scoreBits);
+        return true;
+    }
+
+    void Store(U64 key, int score) {    // |score| <= MAX_EVAL fits in 16 bits
+
+        mTable[key & mMask].store(((key ^ mTag) & ~scoreBits) | (uint16_t)score, std::memory_order_relaxed);
+    }
+};
+
+extern cSharedEvalCache SharedEval;
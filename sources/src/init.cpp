@@ -91,3 +91,24 @@ void POS::Init() { // static init function
     for (int i = 0; i < 8; i++)
         msZobEp[i] = Random64();
 }
+
+// fingerprint of all hash key components, so that a saved hash file is
+// only used by a build that computes the same keys
+
+U64 POS::ZobristSignature() {
+
+    U64 sig = SIDE_RANDOM;
+    auto Mix = [&sig](U64 x) { sig = (sig ^ x) * UINT64_C(0x9E3779B97F4A7C15); };
+
+    for (int i = 0; i < 12; i++)
+        for (int j = 0; j < 64; j++)
+            Mix(msZobPiece[i][j]);
+
+    for (int i = 0; i < 16; i++)
+        Mix(msZobCastle[i]);
+
+    for (int i = 0; i < 8; i++)
+        Mix(msZobEp[i]);
+
+    return sig;
+}
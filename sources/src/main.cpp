@@ -26,6 +26,21 @@ cGlobals Glob;
 #ifdef USE_THREADS
     #include <list>
     std::list<cEngine> Engines(1);
+
+// Grow or shrink the pool of engines to `count`. Engines that stay keep
+// their worker thread, so only the difference is started or stopped.
+
+void ResizeEngines(int count) {
+
+    while ((int)Engines.size() > count)
+        Engines.pop_back();
+    while ((int)Engines.size() < count)
+        Engines.emplace_back((int)Engines.size());
+
+    tDepth.assign(count, 0);
+    Trans.SetThreads(count);
+    PlaceEngines(false);
+}
 #else
     cEngine EngineSingle(0);
 #endif
@@ -159,14 +174,25 @@ void cGlobals::Init() {
     isBenching = false;
     isTuning = false;
     useTaunting = false;
+    useSmpProfiles = true;
+    useSmpDefer = true;
+    smpMode = SMP_LAZY;
     printPv = true;
     isReadingPersonality = false;
     usePersonalityFiles = true;
     useBooksFromPers = true;
     showPersonalityFile = false;
+    pinThreads = false;
+    evalCacheKb = EVAL_CACHE_KB;
+    pawnCacheKb = PAWN_CACHE_KB;
+    shareEvalCache = false;
     numberOfThreads = 1;
 	if (Glob.threadOverride)
 		numberOfThreads = Glob.threadOverride;
+#ifdef USE_THREADS
+    if (numberOfThreads > MaxThreads())
+        numberOfThreads = MaxThreads();
+#endif
 	timeBuffer = 10; // blitz under Arena would require something like 200, but it's user's job
 	game_key = 0;
 
@@ -175,14 +201,12 @@ void cGlobals::Init() {
     // of threads for testing purposes
 
 #ifdef USE_THREADS
-    if (numberOfThreads > 1) { //-V547 get rid of PVS Studio warning
-        Engines.clear();
-        for (int i = 0; i < numberOfThreads; i++)
-            Engines.emplace_back(i);
-    }
+    if (numberOfThreads > 1) //-V547 get rid of PVS Studio warning
+        ResizeEngines(numberOfThreads);
 #endif
 
     shouldClear = false;
+    shouldLoadHash = false;
     isConsole = true;
     eloSlider = true;
 	multiPv = 1;
@@ -190,6 +214,7 @@ void cGlobals::Init() {
     useUciPersonalitySet = false;
     personalityW = "";
     personalityB = "";
+    hashFile = "";
 }
 
 bool cGlobals::CanReadBook() {
@@ -26,8 +26,24 @@ void cEngine::InitMoves(POS *p, MOVES *m, int trans_move, int ref_move, int ref_
     m->transTableMove = trans_move;
     m->refutationMove = ref_move;
     m->refutationSquare = ref_sq;
-    m->killer1 = mKiller[ply][0];
-    m->killer2 = mKiller[ply][1];
+    m->killer1 = mStack[ply].killer[0];
+    m->killer2 = mStack[ply].killer[1];
+    m->badp = m->bad;
+    m->deferp = m->bad + MAX_MOVES;
+}
+
+// Moves are 16 bits, so the flag goes above them. Returns false, and the
+// move has to be searched now, if bad captures and deferred moves would
+// overlap in bad[].
+
+bool cEngine::DeferMove(MOVES *m, int move, int flag) {
+
+    if (m->deferp == m->badp)
+        return false;
+
+    *--m->deferp = move | flag << 16;
+    mSmpStats.deferred++;
+    return true;
 }
 
 int cEngine::NextMove(MOVES *m, int *flag, int ply) {
@@ -37,10 +53,13 @@ int cEngine::NextMove(MOVES *m, int *flag, int ply) {
     switch (m->phase) {
         case 0: // return transposition table move, if legal
             move = m->transTableMove;
-            if (move && m->p->Legal(move)) {
-                m->phase = 1;
-                *flag = MV_HASH;
-                return move;
+            if (move) {
+                if (m->p->Legal(move)) {
+                    m->phase = 1;
+                    *flag = MV_HASH;
+                    return move;
+                }
+                Trans.CountBadMove();
             }
         // fallthrough
 
@@ -129,6 +148,17 @@ int cEngine::NextMove(MOVES *m, int *flag, int ply) {
                 *flag = MV_BADCAPT;
                 return *m->next++;
             }
+
+            m->next = m->bad + MAX_MOVES;
+            m->phase = 9;
+        // fallthrough
+
+        case 9: // return moves deferred by DeferMove(), the first one first
+            if (m->next > m->deferp) {
+                move = *--m->next;
+                *flag = move >> 16;
+                return move & 0xFFFF;
+            }
     }
     return 0;
 }
@@ -140,10 +170,13 @@ int cEngine::NextSpecialMove(MOVES *m, int *flag) {
     switch (m->phase) {
         case 0: // return transposition table move, if legal
             move = m->transTableMove;
-            if (move && m->p->Legal(move)) {
-                m->phase = 1;
-                *flag = MV_HASH;
-                return move;
+            if (move) {
+                if (m->p->Legal(move)) {
+                    m->phase = 1;
+                    *flag = MV_HASH;
+                    return move;
+                }
+                Trans.CountBadMove();
             }
         // fallthrough
 
@@ -238,12 +271,15 @@ void cEngine::ScoreQuiet(MOVES *m, int ply) {
 
     int *movep, *valuep;
 	int mv_score = 0;
+    const int noise = mscProfiles[mProfile].orderNoise;
+    const unsigned seed = (unsigned)mcThreadId * 0x9E3779B9u + (unsigned)ply;
 
     valuep = m->value;
     for (movep = m->move; movep < m->last; movep++) {
         mv_score = mHistory[m->p->mPc[Fsq(*movep)]][Tsq(*movep)]; // use history score
 
         if (Fsq(*movep) == m->refutationSquare) mv_score += 2048;           // but bump up refutation move
+        if (noise) mv_score += ((unsigned)(*movep + seed) * 2654435761u >> 16) & noise; // helper threads shuffle close scores
         *valuep++ = mv_score;
     }
 }
@@ -299,14 +335,20 @@ void cEngine::AgeHist() {
     for (int i = 0; i < 12 * 64; i++)
         ((int *)mHistory)[i] /= 8;
 
-    ZEROARRAY(mKiller);
+    ClearKillers();
 }
 
 void cEngine::ClearHist() {
 
     ZEROARRAY(mHistory);
     ZEROARRAY(mRefutation);
-    ZEROARRAY(mKiller);
+    ClearKillers();
+}
+
+void cEngine::ClearKillers() {
+
+    for (sStackFrame &frame : mStack)
+        frame.killer[0] = frame.killer[1] = 0;
 }
 
 void cEngine::TrimHist() {
@@ -322,6 +364,13 @@ void cEngine::UpdateHistory(POS *p, int last_move, int move, int depth, int ply)
     if (p->mPc[Tsq(move)] != NO_PC || IsProm(move) || MoveType(move) == EP_CAP)
         return;
 
+    // nor on a hash move of another position whose entry passed the 16-bit
+    // check by chance: its from square may be empty, and NO_PC is no row
+    // of mHistory
+
+    if (p->mPc[Fsq(move)] == NO_PC)
+        return;
+
     // Update history table, making sure that scores don't grow too high
 
     mHistory[p->mPc[Fsq(move)]][Tsq(move)] += 2 * depth * depth;
@@ -337,9 +386,9 @@ void cEngine::UpdateHistory(POS *p, int last_move, int move, int depth, int ply)
 
     // Update killer moves
 
-    if (move != mKiller[ply][0]) {
-        mKiller[ply][1] = mKiller[ply][0];
-        mKiller[ply][0] = move;
+    if (move != mStack[ply].killer[0]) {
+        mStack[ply].killer[1] = mStack[ply].killer[0];
+        mStack[ply].killer[0] = move;
     }
 }
 
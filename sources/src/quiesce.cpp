@@ -25,12 +25,14 @@ If not, see <http://www.gnu.org/licenses/>.
 
 int cEngine::QuiesceChecks(POS *p, int ply, int alpha, int beta, int *pv) {
 
-    int best, score, move, new_pv[MAX_PLY];
-    int mv_type, hashFlag;
+    int best, score, move;
+    int mv_type;
     bool is_pv = (alpha != beta - 1);
-    MOVES m[1];
+    MOVES *m = &mStack[ply].moves;
+    int *new_pv = mStack[ply + 1].pv;
+    eData &e = mStack[ply].e;
     UNDO u[1];
-    eData e;
+    TTPROBE hit;
 
     if (p->InCheck()) {
         return QuiesceFlee(p, ply, alpha, beta, pv);
@@ -38,7 +40,7 @@ int cEngine::QuiesceChecks(POS *p, int ply, int alpha, int beta, int *pv) {
 
     // EARLY EXIT AND NODE INITIALIZATION
 
-    Glob.nodes++;
+    CountNode();
     Slowdown();
     
     if (ShouldAbortSearch())
@@ -49,12 +51,13 @@ int cEngine::QuiesceChecks(POS *p, int ply, int alpha, int beta, int *pv) {
     if (p->IsDraw())
         return p->DrawScore();
 
-    move = 0;
-
     // DETERMINE FLOOR VALUE
+    // (before the hash probe, so that a stand-pat cutoff does not pay for it)
 
     best = Evaluate(p, &e);
 
+    const int staticEval = best;
+
     if (best >= beta) {
         return best;
     }
@@ -65,13 +68,18 @@ int cEngine::QuiesceChecks(POS *p, int ply, int alpha, int beta, int *pv) {
 
     // RETRIEVE MOVE FROM TRANSPOSITION TABLE
 
-    if (Trans.Retrieve(p->mHashKey, &move, &score, &hashFlag, alpha, beta, 0, ply)) {
-        
+    Trans.Probe(p->mHashKey, ply, &hit);
+    move = hit.move;
+
+    if (Trans.Cutoff(hit, alpha, beta, 0)) {
+
+        score = hit.score;
         if (score >= beta) {
             UpdateHistory(p, -1, move, 1, ply);
         }
 
         if (!is_pv) {
+            Trans.CountCutoff();
             return score; // !is_pv condition confirmed 2018-08-13
         }
     }
@@ -93,6 +101,7 @@ int cEngine::QuiesceChecks(POS *p, int ply, int alpha, int beta, int *pv) {
         // MAKE MOVE
 
         p->DoMove(move, u);
+        PrefetchHash(p);
         if (p->Illegal()) { 
             p->UndoMove(move, u); 
             continue; 
@@ -110,7 +119,7 @@ int cEngine::QuiesceChecks(POS *p, int ply, int alpha, int beta, int *pv) {
         // BETA CUTOFF
 
         if (score >= beta) {
-            Trans.Store(p->mHashKey, move, score, LOWER, 0, ply);
+            Trans.Store(p->mHashKey, move, score, LOWER, 0, ply, staticEval);
             return score;
         }
 
@@ -134,24 +143,25 @@ int cEngine::QuiesceChecks(POS *p, int ply, int alpha, int beta, int *pv) {
 
     // SAVE RESULT IN THE TRANSPOSITION TABLE
 
-    if (*pv) Trans.Store(p->mHashKey, *pv, best, EXACT, 0, ply);
-    else     Trans.Store(p->mHashKey,   0, best, UPPER, 0, ply);
+    if (*pv) Trans.Store(p->mHashKey, *pv, best, EXACT, 0, ply, staticEval);
+    else     Trans.Store(p->mHashKey,   0, best, UPPER, 0, ply, staticEval);
 
     return best;
 }
 
 int cEngine::QuiesceFlee(POS *p, int ply, int alpha, int beta, int *pv) {
 
-    int best, score, move, new_pv[MAX_PLY];
+    int best, score, move;
     int mv_type, hashFlag;
     bool is_pv = (alpha != beta - 1);
-    MOVES m[1];
+    MOVES *m = &mStack[ply].moves;
+    int *new_pv = mStack[ply + 1].pv;
+    eData &e = mStack[ply].e;
     UNDO u[1];
-    eData e;
 
     // EARLY EXIT AND NODE INITIALIZATION
 
-    Glob.nodes++;
+    CountNode();
     Slowdown();
     
     if (ShouldAbortSearch())
@@ -174,6 +184,7 @@ int cEngine::QuiesceFlee(POS *p, int ply, int alpha, int beta, int *pv) {
         }
 
         if (!is_pv) {
+            Trans.CountCutoff();
             return score;
         }
     }
@@ -196,6 +207,7 @@ int cEngine::QuiesceFlee(POS *p, int ply, int alpha, int beta, int *pv) {
         // MAKE MOVE
 
         p->DoMove(move, u);
+        PrefetchHash(p);
         if (p->Illegal()) { 
             p->UndoMove(move, u); 
             continue; 
@@ -213,7 +225,7 @@ int cEngine::QuiesceFlee(POS *p, int ply, int alpha, int beta, int *pv) {
         // BETA CUTOFF
 
         if (score >= beta) {
-            Trans.Store(p->mHashKey, move, score, LOWER, 0, ply);
+            Trans.Store(p->mHashKey, move, score, LOWER, 0, ply, NO_EVAL);
             return score;
         }
 
@@ -236,19 +248,20 @@ int cEngine::QuiesceFlee(POS *p, int ply, int alpha, int beta, int *pv) {
 
     // SAVE RESULT IN THE TRANSPOSITION TABLE
 
-    if (*pv) Trans.Store(p->mHashKey, *pv, best, EXACT, 0, ply);
-    else     Trans.Store(p->mHashKey,   0, best, UPPER, 0, ply);
+    if (*pv) Trans.Store(p->mHashKey, *pv, best, EXACT, 0, ply, NO_EVAL);
+    else     Trans.Store(p->mHashKey,   0, best, UPPER, 0, ply, NO_EVAL);
 
     return best;
 }
 
 int cEngine::Quiesce(POS *p, int ply, int alpha, int beta, int *pv) {
 
-    int best, score, move, new_pv[MAX_PLY];
+    int best, score, move;
     eColor op = ~p->mSide;
-    MOVES m[1];
+    MOVES *m = &mStack[ply].moves;
+    int *new_pv = mStack[ply + 1].pv;
+    eData &e = mStack[ply].e;
     UNDO u[1];
-    eData e;
 
     // USE DEDICATED EVASION SEARCH WHEN IN CHECK
 
@@ -256,7 +269,7 @@ int cEngine::Quiesce(POS *p, int ply, int alpha, int beta, int *pv) {
         return QuiesceFlee(p, ply, alpha, beta, pv);
     }
 
-    Glob.nodes++;
+    CountNode();
     Slowdown();
 
     // EARLY EXIT
@@ -319,6 +332,7 @@ int cEngine::Quiesce(POS *p, int ply, int alpha, int beta, int *pv) {
         // MAKE MOVE
 
         p->DoMove(move, u);
+        PrefetchHash(p);
         if (p->Illegal()) { 
             p->UndoMove(move, u); 
             continue; 
@@ -72,13 +72,9 @@ If not, see <http://www.gnu.org/licenses/>.
 
 using U64 = uint64_t;
 
-// max size of hashtable
+// max size of hashtable, set by the address space of the platform
 
-#ifdef _WIN64
-static constexpr int max_tt_size_mb = 16384;
-#else
-static constexpr int max_tt_size_mb = 4096;
-#endif
+static constexpr int max_tt_size_mb = sizeof(void *) >= 8 ? 33554432 : 2048; // 32 TB : 2 GB
 
 // define how Rodent is to be compiled
 
@@ -97,10 +93,13 @@ static constexpr int max_tt_size_mb = 4096;
 
 #ifndef NO_THREADS
     #include <thread>
+    #include <mutex>
+    #include <condition_variable>
+    #include <vector>
     #ifndef USE_THREADS
        #define USE_THREADS
     #endif
-    #define MAX_THREADS 48
+    #define MAX_THREADS_FLOOR 48    // the Threads limit on machines with fewer logical cpus, see MaxThreads()
 #else
     #undef USE_THREADS
 #endif
@@ -113,6 +112,7 @@ enum eRank       { RANK_1, RANK_2, RANK_3, RANK_4, RANK_5, RANK_6, RANK_7, RANK_
 enum eCastleFlag { W_KS = 1, W_QS = 2, B_KS = 4, B_QS = 8 };
 enum eGUIs { Other, Arena, WinBoard };
 enum eCastleNotation { KingMove, TakeRook, OOO };
+enum eSmpMode { SMP_LAZY, SMP_YBWC };
 enum eMoveType   { NORMAL, CASTLE, EP_CAP, EP_SET, N_PROM, B_PROM, R_PROM, Q_PROM };
 enum eMoveFlag   { MV_NORMAL, MV_HASH, MV_CAPTURE, MV_REFUTATION, MV_KILLER, MV_BADCAPT };
 enum eHashType   { NONE, UPPER, LOWER, EXACT };
@@ -145,6 +145,7 @@ constexpr int MAX_MOVES = 256;
 constexpr int INF       = 32767;
 constexpr int MATE      = 32000;
 constexpr int MAX_EVAL  = 29999;
+constexpr int NO_EVAL   = -32768;   // static eval not known, as kept in a transposition table entry
 constexpr int MAX_HIST  = 1 << 15;
 constexpr int MAX_PV    = 12;
 
@@ -227,6 +228,18 @@ template<typename T> constexpr T Clip(const T& sc, const T& lim) { if (sc < -lim
     #endif
 #endif
 
+// ask the processor to start loading a cache line that will be needed soon
+// (a hint only, it never faults, whatever the address)
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    #include <xmmintrin.h>
+    static FORCEINLINE void Prefetch(const void *addr) { _mm_prefetch((const char *)addr, _MM_HINT_T0); }
+#elif defined(__GNUC__)
+    static FORCEINLINE void Prefetch(const void *addr) { __builtin_prefetch(addr); }
+#else
+    static FORCEINLINE void Prefetch(const void *) {}
+#endif
+
 // Compiler and architecture dependent versions of FirstOne() function,
 // triggered by defines at the top of this file.
 #ifdef USE_FIRST_ONE_INTRINSICS
@@ -425,6 +438,7 @@ class POS {
     U64 mRepList[256];
 
     NOINLINE static U64 Random64();
+    static U64 ZobristSignature();
 
     static void Init();
     static void Init960();
@@ -510,16 +524,49 @@ struct MOVES {
     int move[MAX_MOVES];
     int value[MAX_MOVES];
     int *badp;
-    int bad[MAX_MOVES];
+    int *deferp;                // bad[] is filled from the top with moves left for last because
+    int bad[MAX_MOVES];         // another thread was searching them, their flag in the high bits
 };
 
+// Transposition table entry. Only 16 bits of the hash key are kept, and
+// they are xor-ed with the packed data folded to 16 bits (lockless
+// hashing), so an entry torn by two threads writing at once fails
+// verification instead of returning a bogus move or score, but for one
+// time in 65536. Search date and bound type share a byte. The static eval
+// of the position comes along, so that a hit spares the search a call to
+// Evaluate(). The short key is what keeps the entry at 10 bytes and six of
+// them in a cluster; hash moves are checked by POS::Legal() anyway.
+
+#pragma pack(push, 2)
 struct ENTRY {
-    U64 key;
-    int16_t date;
+    uint16_t key;
     int16_t move;
     int16_t score;
-    uint8_t flags;
+    int16_t eval;       // side to move's view, NO_EVAL if not known
+    uint8_t dateFlags;  // date in the upper 6 bits, bound type in the lower 2
     uint8_t depth;
+
+    int Date()  const { return dateFlags >> 2; }
+    int Flags() const { return dateFlags & 3; }
+
+    uint16_t Data() const {
+
+        const uint32_t data = ((uint32_t)(uint16_t)move | (uint32_t)(uint16_t)score << 16)
+                            ^ ((uint32_t)dateFlags << 8 | depth) * 0x9E3779B1u
+                            ^ (uint32_t)(uint16_t)eval * 0x85EBCA77u;
+        return (uint16_t)(data ^ data >> 16);
+    }
+};
+#pragma pack(pop)
+
+// Entries are grouped in clusters of one cache line each, so that
+// a probe costs a single memory access
+
+constexpr int CLUSTER_SIZE = 6;
+
+struct alignas(64) CLUSTER {
+    ENTRY entry[CLUSTER_SIZE];
+    char padding[64 - CLUSTER_SIZE * sizeof(ENTRY)];
 };
 
 class eData {
@@ -567,6 +614,8 @@ struct sPawnHashEntry {
     int eg_black_pawns;
 };
 
+#include "evalcache.h"
+
 struct Line {
 	int pv[MAX_PLY];
 };
@@ -790,12 +839,17 @@ class cGlobals {
     bool isConsole;
     bool isTuning;
     bool useTaunting;
+    bool useSmpProfiles;
+    bool useSmpDefer;
+    bool pinThreads;      // search threads are bound to cpus, see PlaceEngines()
+    eSmpMode smpMode;
     bool printPv;
     glob_bool pondering;
     glob_bool infinite;
     bool isReadingPersonality;
     bool useBooksFromPers;
     bool shouldClear;
+    bool shouldLoadHash;
     bool goodbye;
     bool usePersonalityFiles;
 	bool scoreJump;
@@ -803,13 +857,16 @@ class cGlobals {
     bool useUciPersonalitySet;
     std::string personalityW;
     std::string personalityB;
+    std::string hashFile;     // hash contents are saved to and loaded from this file
     glob_int depthReached;
     int moves_from_start; // to restrict book depth for weaker levels
     int numberOfThreads;
+    int evalCacheKb;      // size of the eval cache of every engine
+    int pawnCacheKb;      // and of its pawn cache
+    bool shareEvalCache;  // one eval cache for all engines instead, see cSharedEvalCache
 	int multiPv;
     int timeBuffer;
     U64 game_key;         // random key initialized on ucinewgame to ensure non-repeating random eval modification for weak personalities
-    int avoidMove[MAX_PV + 1]; // list of moves to avoid in multi-pv re-searches
     int gameValue; // for more accurte taunts
     int previousValue;
     int previousTaunt;
@@ -820,9 +877,6 @@ class cGlobals {
     void ClearData();
     void Init();
     bool CanReadBook();
-	bool MoveToAvoid(int move);
-	void ClearAvoidList();
-	void SetAvoidMove(int loc, int move);
 };
 
 extern cGlobals Glob;
@@ -831,8 +885,8 @@ extern cGlobals Glob;
 
 void CheckTimeout();
 
-constexpr int EVAL_HASH_SIZE = 512 * 512 / 4;
-constexpr int PAWN_HASH_SIZE = 512 * 512 / 4;
+constexpr int EVAL_CACHE_KB = 1024;    // default sizes of the eval and pawn caches of every engine,
+constexpr int PAWN_CACHE_KB = 1536;    // 65536 entries each
 
 struct LineFullInfo {
     int depth;
@@ -840,15 +894,118 @@ struct LineFullInfo {
     Line line;
 };
 
+struct sMultiPv {       // root moves kept by a single-pass multi-pv search
+    int count;          // number of lines wanted
+    int found;          // number of lines filled so far
+    int val[MAX_PV + 1];            // 1-based, best first
+    Line line[MAX_PV + 1];
+    int first[MAX_PV + 1];          // moves of the previous iteration's lines, searched first; zero-terminated
+    int firstVal[MAX_PV + 1];       // and their scores
+    int margin;                     // of the aspiration windows, 0 for none
+};
+
+// Lazy SMP helpers search with slightly different settings, so that
+// their trees differ and they find more for the main thread to use
+
+struct sSearchProfile {
+    double lmrBase;     // late move reduction is lmrBase + log(moves) * log(depth) / lmrDiv
+    double lmrDiv;
+    int aspiration;     // first aspiration window margin in Widen()
+    int orderNoise;     // mask of the pseudo-random bonus for quiet moves, 0 for none
+};
+
+constexpr int SEARCH_PROFILES = 4;
+
+struct sSmpStats {      // how often threads got into each other's way
+    U64 marked;         // moves searched with a mark in the busy table
+    U64 duplicated;     // of those, moves another thread was already searching
+    U64 deferred;       // moves a helper put off until the end of its move list
+};
+
+// State of a node as Search() hands it to SearchMove(). When the node
+// becomes a split point, all threads working on it share this copy.
+
+struct sSplitPoint;
+class cEngine;
+
+struct sNodeInfo {
+    int ply;
+    int depth;
+    int lastCaptSquare;
+    int eval;
+    int singMove;
+    int singScore;
+    bool isPv;
+    bool flagInCheck;
+    bool flagPrunableNode;
+    bool improving;
+    bool canSing;
+    bool flagFutility;
+    int movesTried;
+    int quietTried;
+    int movesPlayed[MAX_MOVES];
+#ifdef USE_THREADS
+    bool markBusy;          // moves are marked in the ABDADA busy table
+    sSplitPoint *split;     // NULL unless other threads search moves of this node
+#endif
+};
+
+#ifdef USE_THREADS
+
+// Young Brothers Wait split point: a Search() node whose first move has
+// been searched and whose remaining moves idle threads may take. The lock
+// guards the move list, the bounds, the best score and the node counters.
+
+struct sSplitPoint {
+    std::mutex lock;
+    POS pos;                // the node's position, never modified while split
+    int moves[MAX_MOVES];   // the rest of the owner's move list in its order, flags in the high bits
+    int moveCount;
+    int nextMove;
+    sNodeInfo *node;
+    sSplitPoint *parent;    // split point the owner was working for, if any
+    int alpha;
+    int beta;
+    int best;
+    int bestMove;
+    int pv[MAX_PLY];
+    int evalStack[MAX_PLY]; // owner's stack evals, so that helpers know if eval is improving
+    int rootDepth;
+    int workers;            // helpers inside the split point, guarded by the pool mutex
+    std::atomic<bool> cutoff;
+};
+
+#endif
+
+// One frame of an engine's search stack. The frames are indexed by ply and
+// allocated with the engine, so SearchRoot(), Search() and the quiescence
+// searches keep their move list, node info and eval data here instead of
+// on the C stack. The pv rows form a triangular pv table: the node at a
+// ply returns its line in the row of that ply, which its parent then
+// prefixes with the move leading to it.
+
+struct sStackFrame {
+    MOVES moves;
+    sNodeInfo node;
+    eData e;                // scratch for Evaluate()
+    int pv[MAX_PLY];
+    int eval;               // static eval adjusted by the hash score, to tell if eval is improving
+    int killer[2];
+};
+
 class cEngine {
-    sEvalHashEntry mEvalTT[EVAL_HASH_SIZE];
-    sPawnHashEntry mPawnTT[PAWN_HASH_SIZE];
+    cEvalCache<sEvalHashEntry> mEvalTT;
+    cEvalCache<sPawnHashEntry> mPawnTT;
     int mHistory[12][64];
-    int mEvalStack[MAX_PLY];
-    int mKiller[MAX_PLY][2];
+    char mNodesPad1[64];    // keep other data off mNodes' cache line, however the engine is aligned
+    glob_U64 mNodes;        // nodes of this thread only
+    char mNodesPad2[64 - sizeof(glob_U64)];
     int mRefutation[64][64];
+    sStackFrame mStack[MAX_PLY + 2];
+    sMultiPv *mMulti;       // lines of the multi-pv search in progress, NULL if none
     const int mcThreadId;
     int mRootDepth;
+    int mProfile;           // index into mscProfiles[] for the current search
     bool mFlRootChoice;
 	int mEngSide;
 
@@ -868,6 +1025,7 @@ class cEngine {
     static void InitCaptures(POS *p, MOVES *m);
     void InitMoves(POS *p, MOVES *m, int trans_move, int ref_move, int ref_sq, int ply);
     int NextMove(MOVES *m, int *flag, int ply);
+    bool DeferMove(MOVES *m, int move, int flag);
     int NextSpecialMove(MOVES *m, int *flag);
     static int NextCapture(MOVES *m);
     static void ScoreCaptures(MOVES *m);
@@ -876,6 +1034,7 @@ class cEngine {
     static int BadCapture(POS *p, int move);
     static int MvvLva(POS *p, int move);
     void ClearHist();
+    void ClearKillers();
     void AgeHist();
     void ClearEvalHash();
     void ClearPawnHash();
@@ -887,7 +1046,10 @@ class cEngine {
     void Iterate(POS *p, int *pv);
     int Widen(POS *p, int depth, int *pv, int lastScore);
 	int SearchRoot(POS *p, int ply, int alpha, int beta, int depth, int *pv);
+    int NextRootMove(MOVES *m, int *flag, const int *first, int *firstNext);
+    void AddRootLine(int score, int move, int *newPv);
     int Search(POS *p, int ply, int alpha, int beta, int depth, bool was_null, int last_move, int last_capt_sq, int *pv);
+    bool SearchMove(POS *p, sNodeInfo *n, int move, int moveType, int alpha, int beta, bool first, int *score, int *newPv);
     int QuiesceChecks(POS *p, int ply, int alpha, int beta, int *pv);
     int QuiesceFlee(POS *p, int ply, int alpha, int beta, int *pv);
     int Quiesce(POS *p, int ply, int alpha, int beta, int *pv);
@@ -901,7 +1063,17 @@ class cEngine {
     int SetNullReductionDepth(int depth, int eval, int beta);
     bool TimeTestIntervalReached();
 
+    void CountNode() {      // a plain load and store, as only this thread writes mNodes
+
+#ifdef USE_THREADS
+        mNodes.store(mNodes.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+#else
+        mNodes++;
+#endif
+    }
+
     int Evaluate(POS *p, eData *e);
+    void PrefetchHash(const POS *p);
 
     static int EvaluateChains(POS *p, eColor sd);
     static void EvaluateMaterial(POS *p, eData *e, eColor sd);
@@ -958,7 +1130,10 @@ class cEngine {
     static const int mscFutDepth;      // max depth at which futility pruning is applied
     static const int mscSingDepth;     // min depth at which singular extension is applied
     static const int mscSEEmargin;     // margin for SEE pruning of bad captures
-    static int msLmrSize[2][MAX_PLY][MAX_MOVES];
+    static const int mscDeferDepth;    // min depth at which threads avoid searching the same move
+    static const int mscSplitDepth;    // min depth at which a node may become a split point
+    static const sSearchProfile mscProfiles[SEARCH_PROFILES];
+    static int msLmrSize[SEARCH_PROFILES][2][MAX_PLY][MAX_MOVES];
 
   public:
 
@@ -969,29 +1144,52 @@ class cEngine {
 
     static void InitSearch();
     static void ReadyForBestmove();
+    static U64 SumNodes();
+    static void ClearNodes();
 
     int mPvEng[MAX_PLY];
     int mDpCompleted;
+    int mScoreCompleted;    // score of the last iteration this engine completed
+    sSmpStats mSmpStats;    // for the last search
+
+    static sSmpStats SumSmpStats();
 
     cEngine(const cEngine&) = delete;
     cEngine& operator=(const cEngine&) = delete;
-    cEngine(int th = 0): mcThreadId(th) { ClearAll(); };
+    cEngine(int th = 0);
 
 #ifdef USE_THREADS
-    std::thread mWorker;
-    void StartThinkThread(POS *p) {
-        mDpCompleted = 0;
-        mWorker = std::thread([&] { Think(p); });
-    }
 
-    ~cEngine() { WaitThinkThread(); };  // should fix crash on windows on console closing
-    void WaitThinkThread() { if (mWorker.joinable()) mWorker.join(); }
+    // Every engine keeps one worker thread for its whole life. Between
+    // searches the worker is parked on mWake, so a move costs a wakeup
+    // instead of creating and joining a thread.
+
+    std::thread mWorker;
+    std::mutex mWorkerMutex;
+    std::condition_variable mWake;
+    POS *mTask;             // position the worker thinks about, NULL while parked
+    bool mHelp;             // the worker helps at split points instead of thinking
+    bool mQuit;
+    sSplitPoint *mSplit;    // split point this engine is working for, NULL if none
+
+    void WorkerLoop();
+    bool CanSplit(int depth);
+    void Split(POS *p, MOVES *m, sNodeInfo *n, int alpha, int beta, int *best, int *bestMove, int *pv);
+    void SearchSplit(sSplitPoint *sp);
+    void HelpSplits();
+    void StartThinkThread(POS *p);
+    void StartHelpThread(POS *p);
+    void WaitThinkThread();
+    ~cEngine();             // should fix crash on windows on console closing
 #endif
 
     static void SetMoveTime(int base, int inc, int movestogo);
 
     void Bench(int depth);
     void ClearAll();
+    void ResizeCaches();
+    static void ResizeAllCaches();
+    static void PrintCacheStats();
     void Think(POS *p);
 	void MultiPv(POS *p, int * pv);
 
@@ -1008,6 +1206,13 @@ class cEngine {
 #ifdef USE_THREADS
     #include <list>
     extern std::list<cEngine> Engines;
+    void ResizeEngines(int count);
+    void BenchSmp(int depth, int maxThreads);
+    void BenchVote(int threads, int nodes);
+    void StartEngines(POS *p);
+    void WaitEngines();
+    int MaxThreads();
+    void PlaceEngines(bool verbose);
 #else
     extern cEngine EngineSingle;
 #endif
@@ -1027,6 +1232,10 @@ void PrintMove(int move);
 void PrintSingleOption(int ind);
 void PrintUciOptions();
 void ReadLine(char *, int);
+void HandleSearchInput();
+#ifdef USE_THREADS
+    void WaitSearchInput();
+#endif
 void ReadPersonality(const char *fileName);
 void ReadThreadNumber(const char *fileName);
 void UciLoop();
@@ -1103,8 +1312,20 @@ void printfLog(const char *preStr, const char *fmt, ...);
 #include "chessheapclass.h"
 extern ChessHeapClass Trans;
 
+// Start loading what the search is going to look up in the position just
+// reached: its cluster of the transposition table and its slots in the eval
+// and pawn caches of this engine. Called right after DoMove() and DoNull(),
+// so that the loads overlap with the work done before the lookups.
+
+inline void cEngine::PrefetchHash(const POS *p) {
+
+    Trans.Prefetch(p->mHashKey);
+    Prefetch(SharedEval.Active() ? SharedEval.Entry(p->mHashKey) : mEvalTT.Entry(p->mHashKey));
+    Prefetch(mPawnTT.Entry(p->mPawnKey));
+}
+
 #ifndef NO_THREADS
-    extern int tDepth[MAX_THREADS];
+    extern std::vector<int> tDepth;     // one per engine, resized by ResizeEngines()
 #endif
 
 // I don't belive anybody will use UNICODE in pathnames (only filenames), but
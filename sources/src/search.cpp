@@ -29,13 +29,70 @@ const int cEngine::mscRazorDepth = 4;     // max depth at which razoring is appl
 const int cEngine::mscFutDepth = 6;       // max depth at which futility pruning is applied
 const int cEngine::mscSingDepth = 5;      // min depth at which singular extension is applied
 const int cEngine::mscSEEmargin = 113;    // margin for SEE pruning of bad captures (113 means that at depth 2 losing NxP will be accepted)
+const int cEngine::mscDeferDepth = 4;     // min depth at which threads avoid searching the same move
+const int cEngine::mscSplitDepth = 4;     // min depth at which a node may become a split point
 
 // this variable controls when evaluation function needs to be called for the sake of pruning
 const int cEngine::mscSelectiveDepth = Max(Max(mscSnpDepth, mscRazorDepth), mscFutDepth);
 
 const int cEngine::mscRazorMargin[5] = { 0, 300, 360, 420, 480 };
 const int cEngine::mscFutMargin[7] = { 0, 100, 150, 200, 250, 300, 400 };
-int cEngine::msLmrSize[2][MAX_PLY][MAX_MOVES];
+
+// Profile 0 is the main thread's search. Helper thread n uses profile
+// n % SEARCH_PROFILES: reducing more, reducing less, or shuffling quiet
+// moves with equal history, each with its own aspiration window.
+
+const sSearchProfile cEngine::mscProfiles[SEARCH_PROFILES] = {
+    { 0.33, 2.00,  8,   0 },
+    { 0.50, 1.80, 12,   0 },
+    { 0.20, 2.30, 16,  63 },
+    { 0.33, 2.00,  8, 255 },
+};
+
+int cEngine::msLmrSize[SEARCH_PROFILES][2][MAX_PLY][MAX_MOVES];
+
+#ifdef USE_THREADS
+
+// Moves that some thread is searching right now, ABDADA-style. Each slot
+// holds a tag made of the hash key of the position and the move; a lost
+// or overwritten tag only means that two threads may search the same move.
+
+constexpr int BUSY_SIZE = 1 << 14;
+
+static std::atomic<U64> busyMoves[BUSY_SIZE];
+
+static U64 BusyTag(U64 key, int move) {
+
+    return (key ^ (U64)move * UINT64_C(0x9E3779B97F4A7C15)) | 1;
+}
+
+static std::atomic<U64> &BusySlot(U64 tag) {
+
+    return busyMoves[(tag >> 32) & (BUSY_SIZE - 1)];
+}
+
+static bool IsBusy(U64 tag) {
+
+    return BusySlot(tag).load(std::memory_order_relaxed) == tag;
+}
+
+#endif
+
+// The counters of a node are shared once it becomes a split point
+
+static void LockNode(sNodeInfo *n) {
+
+#ifdef USE_THREADS
+    if (n->split) n->split->lock.lock();
+#endif
+}
+
+static void UnlockNode(sNodeInfo *n) {
+
+#ifdef USE_THREADS
+    if (n->split) n->split->lock.unlock();
+#endif
+}
 
 void cParam::InitAsymmetric(POS *p) {
 
@@ -70,69 +127,142 @@ void cGlobals::ClearData() {
     previousTaunt = TAUNT_GENERIC;
 }
 
-bool cGlobals::MoveToAvoid(int move) {
+void cEngine::InitSearch() { // static init function
 
-    for (int i = 0; i <= MAX_PV; i++) {
-        if (avoidMove[i] == move) return true;
+    // Set depth of late move reduction (formula based on Stockfish)
+    // for every search profile
+
+    for (int prof = 0; prof < SEARCH_PROFILES; prof++) {
+
+        const sSearchProfile &sp = mscProfiles[prof];
+        int (*lmr)[MAX_PLY][MAX_MOVES] = msLmrSize[prof];
+
+        for (int depth = 0; depth < MAX_PLY; depth++)
+            for (int moveCount = 0; moveCount < MAX_MOVES; moveCount++) {
+
+                int r = 0;
+
+                if (depth != 0 && moveCount != 0) {
+                    // +-inf to int is undefined
+                    r = (int)(sp.lmrBase + (log(Min(moveCount, 63)) * log(Min(depth, 63)) / sp.lmrDiv));
+                }
+
+                lmr[0][depth][moveCount] = r;     // zero window node
+                lmr[1][depth][moveCount] = r - 1; // principal variation node (checking for pos. values is in `Search()`)
+
+                // reduction cannot exceed actual depth
+
+                if (lmr[0][depth][moveCount] > depth - 1) {
+                    lmr[0][depth][moveCount] = depth - 1;
+                }
+
+                if (lmr[1][depth][moveCount] > depth - 1) {
+                    lmr[1][depth][moveCount] = depth - 1;
+                }
+            }
     }
+}
+
+cEngine::cEngine(int th): mNodes{0}, mMulti(NULL), mcThreadId(th), mProfile(0) {
 
-    return false;
+    ResizeCaches();
+    ClearAll();
+
+#ifdef USE_THREADS
+    mTask = NULL;
+    mHelp = false;
+    mQuit = false;
+    mSplit = NULL;
+    mWorker = std::thread([this] { WorkerLoop(); });
+#endif
 }
 
-void cGlobals::ClearAvoidList() {
+#ifdef USE_THREADS
 
-    for (int i = 0; i <= MAX_PV; i++) {
-        avoidMove[i] = 0;
+cEngine::~cEngine() {
+
+    WaitThinkThread();
+    {
+        std::lock_guard<std::mutex> lock(mWorkerMutex);
+        mQuit = true;
     }
+    mWake.notify_all();
+    mWorker.join();
 }
 
-void cGlobals::SetAvoidMove(int loc, int move) {
-    avoidMove[loc] = move;
-}
+void cEngine::WorkerLoop() {
 
-void cEngine::InitSearch() { // static init function
+    std::unique_lock<std::mutex> lock(mWorkerMutex);
 
-    // Set depth of late move reduction (formula based on Stockfish)
+    for (;;) {
+        mWake.wait(lock, [this] { return mTask != NULL || mQuit; });
+        if (mQuit) return;
 
-    for (int depth = 0; depth < MAX_PLY; depth++)
-        for (int moveCount = 0; moveCount < MAX_MOVES; moveCount++) {
+        POS *p = mTask;
+        lock.unlock();
+        if (mHelp)
+            HelpSplits();
+        else
+            Think(p);
+        lock.lock();
 
-            int r = 0;
+        mTask = NULL;
+        mHelp = false;
+        mWake.notify_all();
+    }
+}
 
-            if (depth != 0 && moveCount != 0) {
-                // +-inf to int is undefined
-                r = (int)(0.33 + (log(Min(moveCount, 63)) * log(Min(depth, 63)) / 2.00));
-            }
+void cEngine::StartThinkThread(POS *p) {
 
-            msLmrSize[0][depth][moveCount] = r;     // zero window node
-            msLmrSize[1][depth][moveCount] = r - 1; // principal variation node (checking for pos. values is in `Search()`)
+    mDpCompleted = 0;
+    mScoreCompleted = 0;
+    {
+        std::lock_guard<std::mutex> lock(mWorkerMutex);
+        mTask = p;
+    }
+    mWake.notify_all();
+}
 
-            // reduction cannot exceed actual depth
-            
-            if (msLmrSize[0][depth][moveCount] > depth - 1) {
-                msLmrSize[0][depth][moveCount] = depth - 1;
-            }
+void cEngine::StartHelpThread(POS *p) {
 
-            if (msLmrSize[1][depth][moveCount] > depth - 1) {
-                msLmrSize[1][depth][moveCount] = depth - 1;
-            }
-        }
+    mDpCompleted = 0;
+    mScoreCompleted = 0;
+    mPvEng[0] = 0;
+    {
+        std::lock_guard<std::mutex> lock(mWorkerMutex);
+        mHelp = true;
+        mTask = p;
+    }
+    mWake.notify_all();
 }
 
+void cEngine::WaitThinkThread() {
+
+    std::unique_lock<std::mutex> lock(mWorkerMutex);
+    mWake.wait(lock, [this] { return mTask == NULL; });
+}
+
+#endif
+
 void cEngine::Think(POS *p) {
 
     POS curr[1];
+    Trans.SetThread(mcThreadId);
+    mProfile = Glob.useSmpProfiles ? mcThreadId % SEARCH_PROFILES : 0;
+    mSmpStats = {};
     mPvEng[0] = 0; // clear engine's move
     mPvEng[1] = 0; // clear ponder move
-    Glob.ClearAvoidList();
     Glob.scoreJump = false;
     mFlRootChoice = false;
     *curr = *p;
     AgeHist();
-    Iterate(curr, mPvEng);
+    if (Glob.multiPv > 1)
+        MultiPv(curr, mPvEng);
+    else
+        Iterate(curr, mPvEng);
     mEngSide = p->mSide;
 
-    if (Glob.useTaunting) {
+    if (Glob.useTaunting && Glob.multiPv == 1) {
         int tauntEvent = TAUNT_GENERIC;
         int tsq = Tsq(mPvEng[0]);
         if (SqBb(tsq) & p->Filled())
@@ -222,81 +352,135 @@ void cEngine::ShowMultiPVInfo(POS * p, int curMove, int curDepth,
 
 void cEngine::MultiPv(POS * p, int * pv) {
 
-    int bestScore;
-
-    int bestPv = 1;
-    int val[MAX_PV + 1];
-    Line line[MAX_PV + 1];
-
-    int bestPvLastDepth = 0;
+    sMultiPv lines;
     int valLastDepth[MAX_PV + 1];
     Line lineLastDepth[MAX_PV + 1];
 
     for (int i = 0; i <= MAX_PV; i++) {
-        val[i] = 0;
+        lines.val[i] = 0;
+        lines.line[i].pv[0] = 0;
         valLastDepth[i] = 0;
         lineLastDepth[i].pv[0] = 0;
     }
 
-    for (mRootDepth = 1; mRootDepth <= msSearchDepth; mRootDepth++) {
-        Glob.ClearAvoidList();
-        bestScore = -INF;
-        bestPv = 0;
+    // With more threads, the helpers run the same loop without output
+    // and the main thread picks their results from the transposition
+    // table (Lazy SMP). As in Iterate(), every other thread searches
+    // one ply deeper.
 
-        for (int i = 1; i <= Glob.multiPv; i++) {
+    const bool isMain = (mcThreadId == 0);
+    const int offset = mcThreadId & 0x01;
 
-            val[i] = Widen(p, mRootDepth, line[i].pv, val[i]);
+    // All lines come from a single root search, which keeps the best
+    // Glob.multiPv root moves and searches the others against the score
+    // of the worst of them
 
-            if (Glob.abortSearch) {
-                break;
-            }
+    lines.count = Glob.multiPv;
+    lines.first[0] = 0;
+    mMulti = &lines;
 
-            if (val[i] > bestScore) {
-                bestPv = i;
-                bestScore = val[i];
-            };
+    for (mRootDepth = 1 + offset; mRootDepth <= msSearchDepth; mRootDepth++) {
 
-            Glob.SetAvoidMove(i, line[i].pv[0]);
+        // Aspiration: each line of the previous iteration is searched with
+        // a window around its old score first (see SearchRoot()), and no move
+        // is searched above the best of them plus the margin unless it gets
+        // there. Then the worst line is the bound for the remaining moves.
 
-            if (p->Legal(line[i].pv[0]))
-                ShowMultiPVInfo(p, i, mRootDepth, val, line, valLastDepth, lineLastDepth);
-            else
-                // I guess there are not enough possible moves
-                // probably rest of "for" could be skipped, but I'm not sure and almost no time wasted
-                line[i].pv[0] = 0;
+        int beta = INF;
+
+        lines.margin = 0;
+        if (mRootDepth > 6
+        && lineLastDepth[lines.count].pv[0]
+        && Abs(valLastDepth[1]) < MAX_EVAL
+        && Abs(valLastDepth[lines.count]) < MAX_EVAL) {
+            lines.margin = mscProfiles[mProfile].aspiration;
+            beta = valLastDepth[1] + lines.margin;
         }
 
+        lines.found = 0;
+        SearchRoot(p, 0, -INF, beta, mRootDepth, pv);
+
         if (Glob.abortSearch) {
             break;
         }
 
-        /* Already displayed each multipv-step
-        for (int i = Glob.multiPv; i > 0; i--) {
-            if (p->Legal(line[i].pv[0])) {
-                DisplayPv(i, val[i], line[i].pv);
-            }
-        } */
+        // there may be fewer legal moves than lines
 
-        bestPvLastDepth = bestPv;
-        for (int i = 1; i <= Glob.multiPv; i++) {
-            valLastDepth[i] = val[i];
-            lineLastDepth[i] = line[i];
-        }
+        for (int i = lines.found + 1; i <= lines.count; i++)
+            lines.line[i].pv[0] = 0;
+
+        if (isMain)
+            ShowMultiPVInfo(p, lines.count, mRootDepth, lines.val, lines.line, valLastDepth, lineLastDepth);
 
-        // pv = line[bestPv].pv; // "pv" isn't used and also not working in this way. Do we need it?
+        int firstCount = 0;
+
+        for (int i = 1; i <= lines.count; i++) {
+            valLastDepth[i] = lines.val[i];
+            lineLastDepth[i] = lines.line[i];
+            if (lines.line[i].pv[0]) {
+                lines.firstVal[firstCount] = lines.val[i];
+                lines.first[firstCount++] = lines.line[i].pv[0];
+            }
+        }
+        lines.first[firstCount] = 0;
     }
 
+    mMulti = NULL;
+
+    if (!isMain)
+        return;
+
     ReadyForBestmove();
-    if (bestPv == 0) {
-        // no result from current depth, so use previous one
-        if (bestPvLastDepth)
-            p->ExtractMove(lineLastDepth[bestPvLastDepth].pv);
-        else
-            // maybe we are in trouble now? Hope "Widen" can't be aborted without any line
-            p->ExtractMove(line[1].pv);
-    } else {
-        p->ExtractMove(line[bestPv].pv);
+    Glob.abortSearch = true; // stops the helpers
+
+    // an interrupted search still has the best of the moves it finished,
+    // and the move of the previous depth is searched first
+
+    int *bestLine = lines.found ? lines.line[1].pv : lineLastDepth[1].pv;
+
+    for (int i = 0; (pv[i] = bestLine[i]); i++)
+        ;
+    p->ExtractMove(bestLine);
+}
+
+// Picks the next root move: first the moves of the zero-terminated list
+// first[], then those of the move list that are not on it
+
+int cEngine::NextRootMove(MOVES *m, int *flag, const int *first, int *firstNext) {
+
+    int move;
+
+    if (first[*firstNext]) {
+        *flag = MV_HASH;
+        return first[(*firstNext)++];
+    }
+
+    while ((move = NextMove(m, flag, 0))) {
+        int i = 0;
+        while (first[i] && first[i] != move)
+            i++;
+        if (!first[i])
+            return move;
     }
+
+    return 0;
+}
+
+// Enters a root move into the lines of a single-pass multi-pv search,
+// which are sorted best first. When all lines are taken, the worst one
+// is dropped.
+
+void cEngine::AddRootLine(int score, int move, int *newPv) {
+
+    int i = mMulti->found < mMulti->count ? ++mMulti->found : mMulti->count;
+
+    for (; i > 1 && mMulti->val[i - 1] < score; i--) {
+        mMulti->val[i] = mMulti->val[i - 1];
+        mMulti->line[i] = mMulti->line[i - 1];
+    }
+
+    mMulti->val[i] = score;
+    BuildPv(mMulti->line[i].pv, newPv, move);
 }
 
 void cEngine::Iterate(POS *p, int *pv) {
@@ -365,6 +549,7 @@ void cEngine::Iterate(POS *p, int *pv) {
             max_mate_depth /= 3;
             if (max_mate_depth <= mRootDepth) {
                 mDpCompleted = mRootDepth;
+                mScoreCompleted = cur_val;
                 break;
             }
         }
@@ -372,6 +557,7 @@ void cEngine::Iterate(POS *p, int *pv) {
         // Set information about depth
 
         mDpCompleted = mRootDepth;
+        mScoreCompleted = cur_val;
         if (Glob.depthReached < mDpCompleted) {
             Glob.depthReached = mDpCompleted;
         }
@@ -390,7 +576,7 @@ int cEngine::Widen(POS *p, int depth, int *pv, int lastScore) {
     int cur_val = lastScore, alpha, beta;
 
     if (depth > 6 && lastScore < MAX_EVAL) {
-        for (int margin = 8; margin < 500; margin *= 2) {
+        for (int margin = mscProfiles[mProfile].aspiration; margin < 500; margin *= 2) {
             alpha = lastScore - margin;
             beta = lastScore + margin;
             cur_val = SearchRoot(p, 0, alpha, beta, depth, pv);
@@ -432,17 +618,18 @@ int cEngine::Widen(POS *p, int depth, int *pv, int lastScore) {
 
 int cEngine::SearchRoot(POS *p, int ply, int alpha, int beta, int depth, int *pv) {
 
-    int best, score = -INF, move, newDepth, new_pv[MAX_PLY];
-    int moveType, reduction, victim, last_capt, hashFlag;
+    int best, score = -INF, move, newDepth;
+    int moveType, reduction, victim, last_capt;
     int singMove = -1, singScore = -INF;
     int movesTried = 0;
-    int mv_played[MAX_MOVES];
     int quiet_tried = 0;
     int mv_hist_score = 0;
-    MOVES m[1];
+    MOVES *m = &mStack[ply].moves;
+    int *mv_played = mStack[ply].node.movesPlayed;
+    int *new_pv = mStack[ply + 1].pv;
+    eData &e = mStack[ply].e;
     UNDO u[1];
-    eData e;
-    int hashScore = -INF;
+    TTPROBE hit;
 
     bool flagInCheck;
     bool isExtended;
@@ -451,7 +638,7 @@ int cEngine::SearchRoot(POS *p, int ply, int alpha, int beta, int depth, int *pv
 
     // EARLY EXIT AND NODE INITIALIZATION
 
-    Glob.nodes++;
+    CountNode();
     Slowdown();
     
     if (ShouldAbortSearch()) 
@@ -462,18 +649,20 @@ int cEngine::SearchRoot(POS *p, int ply, int alpha, int beta, int depth, int *pv
     if (p->IsDraw() && ply) 
         return p->DrawScore();
     
-    move = 0;
-
     // RETRIEVE MOVE FROM TRANSPOSITION TABLE
 
-    if (Trans.Retrieve(p->mHashKey, &move, &hashScore, &hashFlag, alpha, beta, depth, ply)) {
+    Trans.Probe(p->mHashKey, ply, &hit);
+    move = hit.move;
+
+    if (Trans.Cutoff(hit, alpha, beta, depth)) {
 
-        if (hashScore >= beta) {
+        if (hit.score >= beta) {
             UpdateHistory(p, -1, move, depth, ply);
         }
 
         if (!isPv && Par.searchSkill > 0) {
-            return hashScore;
+            Trans.CountCutoff();
+            return hit.score;
         }
 
     }
@@ -481,10 +670,10 @@ int cEngine::SearchRoot(POS *p, int ply, int alpha, int beta, int depth, int *pv
     // PREPARE FOR SINGULAR EXTENSION, SENPAI-STYLE
 
     if (isPv && depth > mscSingDepth) {
-        if (Trans.Retrieve(p->mHashKey, &singMove, &singScore, &hashFlag, alpha, beta, depth - 4, ply)) {
-            if (hashFlag & LOWER) {
-                canSing = true;
-            }
+        if (Trans.Cutoff(hit, alpha, beta, depth - 4) && hit.flags & LOWER) {
+            singMove = hit.move;
+            singScore = hit.score;
+            canSing = true;
         }
     }
 
@@ -511,14 +700,22 @@ int cEngine::SearchRoot(POS *p, int ply, int alpha, int beta, int depth, int *pv
     best = -INF;
     InitMoves(p, m, move, Refutation(move), -1, ply);
 
+    // in multi-pv mode, the lines of the previous iteration go first,
+    // so that the other moves are searched against a good score
+
+    static const int noMoves[1] = { 0 };
+    const int *firstMoves = mMulti ? mMulti->first : noMoves;
+    int firstNext = 0;
+
     // MAIN LOOP
 
-    while ((move = NextMove(m, &moveType, ply))) {
+    while ((move = NextRootMove(m, &moveType, firstMoves, &firstNext))) {
 
         // this thread appears to be lagging behind
-        // - let's restart it
+        // - let's restart it (in multi-pv mode, later lines
+        // are searched to a depth the first one has finished)
 
-        if (Glob.finishedDepth >= depth && Glob.numberOfThreads > 1)
+        if (Glob.finishedDepth >= depth && Glob.numberOfThreads > 1 && Glob.multiPv == 1)
             return 0;
 
         // MAKE MOVE
@@ -535,19 +732,13 @@ int cEngine::SearchRoot(POS *p, int ply, int alpha, int beta, int depth, int *pv
         }
 
         p->DoMove(move, u);
+        PrefetchHash(p);
 
         if (p->Illegal()) {
             p->UndoMove(move, u);
             continue;
         }
 
-        // DON'T SEARCH THE SAME MOVES IN MULTI-PV MODE 
-
-        if (Glob.MoveToAvoid(move)) {
-            p->UndoMove(move, u);
-            continue;
-        }
-
         // GATHER INFO ABOUT THE MOVE
 
         isExtended = false;
@@ -602,14 +793,14 @@ int cEngine::SearchRoot(POS *p, int ply, int alpha, int beta, int depth, int *pv
         && movesTried > 3
         && !flagInCheck
         && !p->InCheck()
-        && msLmrSize[isPv][depth][movesTried] > 0
+        && msLmrSize[mProfile][isPv][depth][movesTried] > 0
         && moveType == MV_NORMAL
         && mv_hist_score < Par.histLimit
         && MoveType(move) != CASTLE) {
 
             // read reduction amount from the table
 
-            reduction = (int)msLmrSize[isPv][depth][movesTried];
+            reduction = (int)msLmrSize[mProfile][isPv][depth][movesTried];
 
             // increase reduction on bad history score
 
@@ -626,10 +817,24 @@ int cEngine::SearchRoot(POS *p, int ply, int alpha, int beta, int depth, int *pv
     research:
 
         // PRINCIPAL VARIATION SEARCH
+        // (in multi-pv mode, until every line has a move)
 
-        if (best == -INF)
-            score = -Search(p, ply + 1, -beta, -alpha, newDepth, false, move, last_capt, new_pv);
-        else {
+        if (best == -INF || (mMulti && mMulti->found < mMulti->count)) {
+            int lo = alpha, hi = beta;
+
+            // a line of the previous iteration is first searched with a
+            // narrow window around its old score (the moves of firstMoves[]
+            // never come again from the move list)
+
+            if (mMulti && mMulti->margin && firstNext && firstMoves[firstNext - 1] == move) {
+                lo = Max(alpha, mMulti->firstVal[firstNext - 1] - mMulti->margin);
+                hi = Min(beta, mMulti->firstVal[firstNext - 1] + mMulti->margin);
+            }
+
+            score = -Search(p, ply + 1, -hi, -lo, newDepth, false, move, last_capt, new_pv);
+            if (!Glob.abortSearch && ((score <= lo && lo > alpha) || (score >= hi && hi < beta)))
+                score = -Search(p, ply + 1, -beta, -alpha, newDepth, false, move, last_capt, new_pv);
+        } else {
             score = -Search(p, ply + 1, -alpha - 1, -alpha, newDepth, false, move, last_capt, new_pv);
             if (!Glob.abortSearch && score > alpha && score < beta)
                 score = -Search(p, ply + 1, -beta, -alpha, newDepth, false, move, last_capt, new_pv);
@@ -643,6 +848,13 @@ int cEngine::SearchRoot(POS *p, int ply, int alpha, int beta, int depth, int *pv
             goto research;
         }
 
+        // IN MULTI-PV MODE BETA IS ONLY AN ASPIRATION BOUND: LIFT IT
+
+        if (mMulti && score >= beta && beta < INF && !Glob.abortSearch) {
+            beta = INF;
+            goto research;
+        }
+
         // UNDO MOVE
 
         p->UndoMove(move, u);
@@ -659,7 +871,7 @@ int cEngine::SearchRoot(POS *p, int ply, int alpha, int beta, int depth, int *pv
                     DecreaseHistory(p, mv_played[mv], depth);
                 }
             }
-            Trans.Store(p->mHashKey, move, score, LOWER, depth, ply);
+            Trans.Store(p->mHashKey, move, score, LOWER, depth, ply, NO_EVAL);
 
             // At root, change the best move and show the new pv
 
@@ -675,13 +887,24 @@ int cEngine::SearchRoot(POS *p, int ply, int alpha, int beta, int depth, int *pv
 
         if (score > best) {
             best = score;
-            if (score > alpha) {
+            if (score > alpha && !mMulti) {
                 alpha = score;
                 BuildPv(pv, new_pv, move);
                 if (Glob.multiPv == 1) DisplayPv(0, score, pv);
             }
         }
 
+        // NEW MULTI-PV LINE: once all lines are taken, the worst
+        // of them is the score other moves must beat
+
+        if (score > alpha && mMulti) {
+            AddRootLine(score, move, new_pv);
+            if (mMulti->found == mMulti->count)
+                alpha = mMulti->val[mMulti->count];
+            for (int i = 0; (pv[i] = mMulti->line[1].pv[i]); i++)
+                ;
+        }
+
     } // end of main loop
 
     // RETURN CORRECT CHECKMATE/STALEMATE SCORE
@@ -698,10 +921,10 @@ int cEngine::SearchRoot(POS *p, int ply, int alpha, int beta, int depth, int *pv
                 DecreaseHistory(p, mv_played[mv], depth);
             }
         }
-        Trans.Store(p->mHashKey, *pv, best, EXACT, depth, ply);
+        Trans.Store(p->mHashKey, *pv, best, EXACT, depth, ply, NO_EVAL);
     }
     else
-        Trans.Store(p->mHashKey, 0, best, UPPER, depth, ply);
+        Trans.Store(p->mHashKey, 0, best, UPPER, depth, ply, NO_EVAL);
 
     return best;
 }
@@ -709,21 +932,17 @@ int cEngine::SearchRoot(POS *p, int ply, int alpha, int beta, int depth, int *pv
 
 int cEngine::Search(POS *p, int ply, int alpha, int beta, int depth, bool wasNull, int lastMove, int lastCaptSquare, int *pv) {
 
-    int best, score = -INF, nullScore, move, newDepth, newPv[MAX_PLY];
-    int moveType, reduction, victim, lastCaptTarget, hashFlag, nullHashFlag;
+    int best, score = -INF, move, newDepth;
+    int moveType;
     int nullRefutation = -1, refutationSqare = -1, singMove = -1, singScore = -INF;
-    int movesTried = 0;
-    int movesPlayed[MAX_MOVES];
-    int quietTried = 0;
-    int moveHistScore = 0;
-    MOVES m[1];
+    MOVES *m = &mStack[ply].moves;
+    sNodeInfo *n = &mStack[ply].node;
+    int *newPv = mStack[ply + 1].pv;
+    eData &e = mStack[ply].e;
     UNDO u[1];
-    eData e;
-    int moveSEEscore = 0; // see score of a bad capture
-    int hashScore = -INF;
+    TTPROBE hit;
 
     bool flagInCheck;
-    bool flagFutility = false;
     bool isPv = (alpha != beta - 1);
     bool canSing = false;
 
@@ -735,7 +954,7 @@ int cEngine::Search(POS *p, int ply, int alpha, int beta, int depth, bool wasNul
 
     // EARLY EXIT AND NODE INITIALIZATION
 
-    Glob.nodes++;
+    CountNode();
     Slowdown();
 
     if (ShouldAbortSearch()) 
@@ -766,30 +985,33 @@ int cEngine::Search(POS *p, int ply, int alpha, int beta, int depth, bool wasNul
         }
     }
 
-    bool hasTT = false;
-
     // RETRIEVE MOVE FROM TRANSPOSITION TABLE
+    // (one probe, all decisions below are taken from this copy of the entry)
 
-    if (Trans.Retrieve(p->mHashKey, &move, &hashScore, &hashFlag, alpha, beta, depth, ply)) {
+    Trans.Probe(p->mHashKey, ply, &hit);
+    move = hit.move;
 
-        hasTT = true;
+    bool hasTT = Trans.Cutoff(hit, alpha, beta, depth);
 
-        if (hashScore >= beta) {
+    if (hasTT) {
+
+        if (hit.score >= beta) {
             UpdateHistory(p, lastMove, move, depth, ply);
         }
 
         if (!isPv && Par.searchSkill > 0) {
-            return hashScore;
+            Trans.CountCutoff();
+            return hit.score;
         }
     }
 
     // PREPARE FOR SINGULAR EXTENSION, SENPAI-STYLE
 
     if (isPv && depth > mscSingDepth) {
-        if (Trans.Retrieve(p->mHashKey, &singMove, &singScore, &hashFlag, alpha, beta, depth - 4, ply)) {
-            if (hashFlag & LOWER) {
-                canSing = true;
-            }
+        if (Trans.Cutoff(hit, alpha, beta, depth - 4) && hit.flags & LOWER) {
+            singMove = hit.move;
+            singScore = hit.score;
+            canSing = true;
         }
     }
 
@@ -808,19 +1030,24 @@ int cEngine::Search(POS *p, int ply, int alpha, int beta, int depth, bool wasNul
         && !isPv;
 
     // GET EVAL SCORE FOR PRUNING/REDUCTION DECISIONS
+    // (a hash entry may already know the static eval)
 
     int eval = 0;
+    int staticEval = NO_EVAL;
     if (flagInCheck) eval = -INF;
-    else eval = Evaluate(p, &e);
+    else if (hit.eval != NO_EVAL) {
+        eval = staticEval = hit.eval;
+        Trans.CountEval();
+    } else eval = staticEval = Evaluate(p, &e);
 
     // ADJUST EVAL USING HASH SCORE,THEN SAVE TO STACK
 
     if (hasTT) {
-        if (hashFlag & (hashScore > eval ? LOWER : UPPER))
-            eval = hashScore;
+        if (hit.flags & (hit.score > eval ? LOWER : UPPER))
+            eval = hit.score;
     }
 
-    mEvalStack[ply] = eval;
+    mStack[ply].eval = eval;
 
     // CHECK IF SCORE IS IMPROVING
 
@@ -828,7 +1055,7 @@ int cEngine::Search(POS *p, int ply, int alpha, int beta, int depth, bool wasNul
 
     if (ply > 2
     && !flagInCheck
-    && eval > mEvalStack[ply - 2]) {
+    && eval > mStack[ply - 2].eval) {
         improving = true;
     }
 
@@ -860,18 +1087,19 @@ int cEngine::Search(POS *p, int ply, int alpha, int beta, int depth, bool wasNul
         // omit null move search if normal search to the same depth wouldn't exceed beta
         // (sometimes we can check it for free via hash table)
 
-        if (Trans.Retrieve(p->mHashKey, &move, &nullScore, &nullHashFlag, alpha, beta, newDepth, ply)) {
-            if (nullScore < beta) goto avoidNull;
+        if (Trans.Cutoff(hit, alpha, beta, newDepth)) {
+            if (hit.score < beta) goto avoidNull;
         }
 
         p->DoNull(u);
+        PrefetchHash(p);
         if (newDepth <= 0) score = -QuiesceChecks(p, ply + 1, -beta, -beta + 1, newPv);
         else               score = -Search(p, ply + 1, -beta, -beta + 1, newDepth, true, 0, -1, newPv);
 
         // get location of a piece whose capture refuted null move
         // its escape will be prioritised in the move ordering
 
-        Trans.Retrieve(p->mHashKey, &nullRefutation, &nullScore, &nullHashFlag, alpha, beta, depth, ply);
+        Trans.RetrieveMove(p->mHashKey, &nullRefutation);
         if (nullRefutation > 0) refutationSqare = Tsq(nullRefutation);
 
         p->UndoNull(u);
@@ -935,279 +1163,386 @@ avoidNull:
     best = -INF;
     InitMoves(p, m, move, Refutation(move), refutationSqare, ply);
 
+    n->ply = ply;
+    n->depth = depth;
+    n->lastCaptSquare = lastCaptSquare;
+    n->eval = eval;
+    n->singMove = singMove;
+    n->singScore = singScore;
+    n->isPv = isPv;
+    n->flagInCheck = flagInCheck;
+    n->flagPrunableNode = flagPrunableNode;
+    n->improving = improving;
+    n->canSing = canSing;
+    n->flagFutility = false;
+    n->movesTried = 0;
+    n->quietTried = 0;
+
+#ifdef USE_THREADS
+    n->split = NULL;
+    n->markBusy = Glob.numberOfThreads > 1 && Glob.smpMode == SMP_LAZY && depth >= mscDeferDepth;
+    const bool deferBusy = n->markBusy && Glob.useSmpDefer && mcThreadId != 0;
+#endif
+
     // MAIN LOOP
 
     while ((move = NextMove(m, &moveType, ply))) {
 
-        // SET FUTILITY PRUNING FLAG
-        // before the first applicable move is tried
+#ifdef USE_THREADS
 
-        if (moveType == MV_NORMAL
-        && Par.searchSkill > 4
-        && quietTried == 0
-        && flagPrunableNode
-        && depth <= mscFutDepth) {
-            if (eval + mscFutMargin[depth] < beta) flagFutility = true;
-        }
+        // ABDADA: WHILE ANOTHER THREAD IS SEARCHING THIS MOVE,
+        // A HELPER LEAVES IT FOR THE END OF ITS MOVE LIST
 
-        // GET MOVE HISTORY SCORE
+        if (deferBusy && n->movesTried && m->phase != 9 && IsBusy(BusyTag(p->mHashKey, move))
+        && DeferMove(m, move, moveType))
+            continue;
+#endif
 
-        moveHistScore = mHistory[p->mPc[Fsq(move)]][Tsq(move)];
+        // SEARCH THE MOVE, UNLESS IT IS ILLEGAL OR PRUNED
 
-        // GET SEE SCORE OF A BAD CAPTURE
+        if (!SearchMove(p, n, move, moveType, alpha, beta, best == -INF, &score, newPv))
+            continue;
 
-        if (moveType == MV_BADCAPT) {
-            moveSEEscore = p->Swap(Fsq(move), Tsq(move));
-        }
+        if (ShouldAbortSearch()) 
+            return 0;
 
-        // SAVE INFORMATION ABOUT A POSSIBLE CAPTURE VICTIM
+        // BETA CUTOFF
 
-        victim = p->TpOnSq(Tsq(move));
-        if (victim != NO_TP) {
-            lastCaptTarget = Tsq(move);
-        } else {
-            lastCaptTarget = -1;
+        if (score >= beta) {
+#ifdef USE_THREADS
+        betaCutoff:
+#endif
+            if (!flagInCheck) {
+                UpdateHistory(p, lastMove, move, depth, ply);
+                for (int mv = 0; mv < n->movesTried; mv++) {
+                    DecreaseHistory(p, n->movesPlayed[mv], depth);
+                }
+            }
+            Trans.Store(p->mHashKey, move, score, LOWER, depth, ply, staticEval);
+
+            return score;
         }
 
-        // MAKE MOVE
+        // NEW BEST MOVE
 
-        p->DoMove(move, u);
-        if (p->Illegal()) { 
-            p->UndoMove(move, u); 
-            continue; 
+        if (score > best) {
+            best = score;
+            if (score > alpha) {
+                alpha = score;
+                BuildPv(pv, newPv, move);
+            }
         }
 
-        // GATHER INFO ABOUT THE MOVE
+#ifdef USE_THREADS
 
-        movesPlayed[movesTried] = move;
-        movesTried++;
-        
-        if (!ply && movesTried > 1) {
-            mFlRootChoice = true;
-        }
+        // YOUNG BROTHERS WAIT: ONCE THE FIRST MOVE HAS BEEN SEARCHED,
+        // IDLE THREADS MAY TAKE THE REST OF THE MOVE LIST
 
-        if (moveType == MV_NORMAL) {
-            quietTried++;
-        }
+        if (CanSplit(depth)) {
+            Split(p, m, n, alpha, beta, &best, &move, pv);
 
-        if (ply == 0 && !Par.shut_up && depth > 16 && Glob.numberOfThreads == 1) {
-            DisplayCurrmove(move, movesTried);
+            if (ShouldAbortSearch())
+                return 0;
+
+            if (best >= beta) {
+                score = best;
+                goto betaCutoff;
+            }
+            break;
         }
+#endif
 
-        // SET NEW SEARCH DEPTH
+    } // end of main loop
 
-        newDepth = depth - 1;
+    // RETURN CORRECT CHECKMATE/STALEMATE SCORE
 
-        // EXTENSIONS
-        // please note they behave in an unusual way: if there are
-        // more than one reason to extend, we can extend by more
-        // than one ply. It would be preferable to avoid that,
-        // but tests show that with current extension restrictions
-        // it works best.
+    if (best == -INF) {
+        return p->InCheck() ? -MATE + ply : p->DrawScore();
+    }
 
-        // 1. check extension, applied in pv nodes or at low depth
+    // SAVE RESULT IN THE TRANSPOSITION TABLE
 
-        if (isPv || depth < 8) {
-            newDepth += p->InCheck();
-        };
+    if (*pv) {
+        if (!flagInCheck) {
+            UpdateHistory(p, lastMove, *pv, depth, ply);
+            for (int mv = 0; mv < n->movesTried; mv++) {
+                DecreaseHistory(p, n->movesPlayed[mv], depth);
+            }
+        }
+        Trans.Store(p->mHashKey, *pv, best, EXACT, depth, ply, staticEval);
+    } else
+        Trans.Store(p->mHashKey, 0, best, UPPER, depth, ply, staticEval);
 
-        // 2. recapture extension in pv-nodes
+    return best;
+}
 
-        if (isPv && Tsq(move) == lastCaptSquare) {
-            newDepth += 1;
-        };
+// Searches a single move of the node described by n: sets the futility
+// flag, makes the move, extends, prunes or reduces it and returns its
+// score in *score. Returns false if the move turned out to be illegal
+// or was pruned. At a split point several threads share n, so its move
+// counters are only touched under the split point lock.
 
-        // 3. pawn to 7th rank extension at the tips of pv-line
+bool cEngine::SearchMove(POS *p, sNodeInfo *n, int move, int moveType, int alpha, int beta, bool first, int *score, int *newPv) {
 
-        if (isPv
-        && depth < 6
-        && p->TpOnSq(Tsq(move)) == P
-        && (SqBb(Tsq(move)) & (RANK_2_BB | RANK_7_BB))) {
-            newDepth += 1;
-        };
+    const int ply = n->ply, depth = n->depth;
+    int newDepth, reduction, victim, lastCaptTarget;
+    int moveSEEscore = 0; // see score of a bad capture
+    UNDO u[1];
+#ifdef USE_THREADS
+    const U64 busyTag = n->markBusy ? BusyTag(p->mHashKey, move) : 0;
+#endif
 
-        // 4. singular extension, Senpai-style
+    // SET FUTILITY PRUNING FLAG
+    // before the first applicable move is tried
 
-        if (isPv
-        && depth > mscSingDepth
-        && move == singMove
-        && canSing) {
-            int newAlpha = -singScore - 50;
-            int mockPv;
-            int sc = Search(p, ply+1, newAlpha, newAlpha + 1, depth - 4, false, -1, -1, &mockPv);
-            if (sc <= newAlpha) {
-                newDepth += 1;
-            }
-        }
+    LockNode(n);
+    if (moveType == MV_NORMAL
+    && Par.searchSkill > 4
+    && n->quietTried == 0
+    && n->flagPrunableNode
+    && depth <= mscFutDepth) {
+        if (n->eval + mscFutMargin[depth] < beta) n->flagFutility = true;
+    }
+    UnlockNode(n);
 
-        // FUTILITY PRUNING
+    // GET MOVE HISTORY SCORE
 
-        if (flagFutility
-        && !p->InCheck()
-        && moveHistScore < Par.histLimit
-        && (moveType == MV_NORMAL)
-        && movesTried > 1) {
-            p->UndoMove(move, u);
-            continue;
-        }
+    const int moveHistScore = mHistory[p->mPc[Fsq(move)]][Tsq(move)];
 
-        // LATE MOVE PRUNING
+    // GET SEE SCORE OF A BAD CAPTURE
 
-        const int lmpTable[][10 + 1] = {
-            { 0, 3, 4, 6, 10, 15, 21, 28, 36, 45, 55 },
-            { 0, 5, 6, 9, 15, 23, 32, 42, 54, 68, 83 }
-        };
+    if (moveType == MV_BADCAPT) {
+        moveSEEscore = p->Swap(Fsq(move), Tsq(move));
+    }
 
-        if (flagPrunableNode
-        && Par.searchSkill > 5
-        && depth <= 10
-        && quietTried > lmpTable[improving][depth]
-        && !p->InCheck()
-        && moveHistScore < Par.histLimit
-        && moveType == MV_NORMAL) {
-            p->UndoMove(move, u);
-            continue;
-        }
+    // SAVE INFORMATION ABOUT A POSSIBLE CAPTURE VICTIM
 
-        // SEE pruning of bad captures
+    victim = p->TpOnSq(Tsq(move));
+    if (victim != NO_TP) {
+        lastCaptTarget = Tsq(move);
+    } else {
+        lastCaptTarget = -1;
+    }
 
-        if (flagPrunableNode
-        && (moveType == MV_BADCAPT)
-        && !p->InCheck()
-        && depth <= 3
-        && !isPv) {
-            if (moveSEEscore < -mscSEEmargin * depth) {
-              //  p->PrintBoard();
-              //  printf("%s depth marg %d %d val %d\n", MoveToStr(move), -mscSEEmargin * depth, depth, moveSEEscore);
-                p->UndoMove(move, u);
-                continue;
-            }
-        }
+    // MAKE MOVE
 
-        // LMR 1: NORMAL MOVES
+    p->DoMove(move, u);
+    PrefetchHash(p);
+    if (p->Illegal()) { 
+        p->UndoMove(move, u); 
+        return false; 
+    }
 
-        reduction = 0;
+    // GATHER INFO ABOUT THE MOVE
 
-        if (depth > 2
-        && Par.searchSkill > 2
-        && movesTried > 3
-        && msLmrSize[isPv][depth][movesTried] > 0
-        && moveType == MV_NORMAL
-        && moveHistScore < Par.histLimit
-        && MoveType(move) != CASTLE) {
+    LockNode(n);
+    n->movesPlayed[n->movesTried] = move;
+    n->movesTried++;
 
-            reduction = SetLateMoveReduction(isPv, depth, movesTried, moveHistScore, improving);
+    if (moveType == MV_NORMAL) {
+        n->quietTried++;
+    }
 
-            // reduction cannot exceed actual depth
+    const int movesTried = n->movesTried;
+    const int quietTried = n->quietTried;
+    const bool flagFutility = n->flagFutility;
+    UnlockNode(n);
+    
+    if (!ply && movesTried > 1) {
+        mFlRootChoice = true;
+    }
 
-            if (reduction >= newDepth) {
-                reduction = newDepth - 1;
-            }
+    if (ply == 0 && !Par.shut_up && depth > 16 && Glob.numberOfThreads == 1) {
+        DisplayCurrmove(move, movesTried);
+    }
 
-            // reduction when in check is smaller
+    // SET NEW SEARCH DEPTH
 
-            if (p->InCheck() && reduction > 1) reduction -= 1;
-            
-            newDepth = newDepth - reduction;
-        }
+    newDepth = depth - 1;
 
-        // LMR 2: MARGINAL REDUCTION OF BAD CAPTURES
+    // EXTENSIONS
+    // please note they behave in an unusual way: if there are
+    // more than one reason to extend, we can extend by more
+    // than one ply. It would be preferable to avoid that,
+    // but tests show that with current extension restrictions
+    // it works best.
 
-        if (depth > 2
-        && Par.searchSkill > 8
-        && movesTried > 6
-        && !flagInCheck
-        && !p->InCheck()
-        && (moveType == MV_BADCAPT)
-        && !isPv) {
-            reduction = 1;
-            newDepth -= reduction;
-        }
+    // 1. check extension, applied in pv nodes or at low depth
 
-    research:
+    if (n->isPv || depth < 8) {
+        newDepth += p->InCheck();
+    };
 
-        // PRINCIPAL VARIATION SEARCH
+    // 2. recapture extension in pv-nodes
 
-        if (best == -INF)
-            score = -Search(p, ply + 1, -beta, -alpha, newDepth, false, move, lastCaptTarget, newPv);
-        else {
-            score = -Search(p, ply + 1, -alpha - 1, -alpha, newDepth, false, move, lastCaptTarget, newPv);
-            if (!Glob.abortSearch && score > alpha && score < beta)
-                score = -Search(p, ply + 1, -beta, -alpha, newDepth, false, move, lastCaptTarget, newPv);
-        }
+    if (n->isPv && Tsq(move) == n->lastCaptSquare) {
+        newDepth += 1;
+    };
 
-        // DON'T REDUCE A MOVE THAT SCORED ABOVE ALPHA
+    // 3. pawn to 7th rank extension at the tips of pv-line
 
-        if (score > alpha && reduction) {
-            newDepth = newDepth + reduction;
-            reduction = 0;
-            goto research;
+    if (n->isPv
+    && depth < 6
+    && p->TpOnSq(Tsq(move)) == P
+    && (SqBb(Tsq(move)) & (RANK_2_BB | RANK_7_BB))) {
+        newDepth += 1;
+    };
+
+    // 4. singular extension, Senpai-style
+
+    if (n->isPv
+    && depth > mscSingDepth
+    && move == n->singMove
+    && n->canSing) {
+        int newAlpha = -n->singScore - 50;
+        int mockPv;
+        int sc = Search(p, ply+1, newAlpha, newAlpha + 1, depth - 4, false, -1, -1, &mockPv);
+        if (sc <= newAlpha) {
+            newDepth += 1;
         }
+    }
 
-        // UNDO MOVE
+    // FUTILITY PRUNING
 
+    if (flagFutility
+    && !p->InCheck()
+    && moveHistScore < Par.histLimit
+    && (moveType == MV_NORMAL)
+    && movesTried > 1) {
         p->UndoMove(move, u);
+        return false;
+    }
 
-        if (ShouldAbortSearch()) 
-            return 0;
+    // LATE MOVE PRUNING
 
-        // BETA CUTOFF
+    const int lmpTable[][10 + 1] = {
+        { 0, 3, 4, 6, 10, 15, 21, 28, 36, 45, 55 },
+        { 0, 5, 6, 9, 15, 23, 32, 42, 54, 68, 83 }
+    };
 
-        if (score >= beta) {
-            if (!flagInCheck) {
-                UpdateHistory(p, lastMove, move, depth, ply);
-                for (int mv = 0; mv < movesTried; mv++) {
-                    DecreaseHistory(p, movesPlayed[mv], depth);
-                }
-            }
-            Trans.Store(p->mHashKey, move, score, LOWER, depth, ply);
+    if (n->flagPrunableNode
+    && Par.searchSkill > 5
+    && depth <= 10
+    && quietTried > lmpTable[n->improving][depth]
+    && !p->InCheck()
+    && moveHistScore < Par.histLimit
+    && moveType == MV_NORMAL) {
+        p->UndoMove(move, u);
+        return false;
+    }
 
-            return score;
+    // SEE pruning of bad captures
+
+    if (n->flagPrunableNode
+    && (moveType == MV_BADCAPT)
+    && !p->InCheck()
+    && depth <= 3
+    && !n->isPv) {
+        if (moveSEEscore < -mscSEEmargin * depth) {
+          //  p->PrintBoard();
+          //  printf("%s depth marg %d %d val %d\n", MoveToStr(move), -mscSEEmargin * depth, depth, moveSEEscore);
+            p->UndoMove(move, u);
+            return false;
         }
+    }
 
-        // NEW BEST MOVE
+    // LMR 1: NORMAL MOVES
 
-        if (score > best) {
-            best = score;
-            if (score > alpha) {
-                alpha = score;
-                BuildPv(pv, newPv, move);
-            }
+    reduction = 0;
+
+    if (depth > 2
+    && Par.searchSkill > 2
+    && movesTried > 3
+    && msLmrSize[mProfile][n->isPv][depth][movesTried] > 0
+    && moveType == MV_NORMAL
+    && moveHistScore < Par.histLimit
+    && MoveType(move) != CASTLE) {
+
+        reduction = SetLateMoveReduction(n->isPv, depth, movesTried, moveHistScore, n->improving);
+
+        // reduction cannot exceed actual depth
+
+        if (reduction >= newDepth) {
+            reduction = newDepth - 1;
         }
 
-    } // end of main loop
+        // reduction when in check is smaller
 
-    // RETURN CORRECT CHECKMATE/STALEMATE SCORE
+        if (p->InCheck() && reduction > 1) reduction -= 1;
+        
+        newDepth = newDepth - reduction;
+    }
 
-    if (best == -INF) {
-        return p->InCheck() ? -MATE + ply : p->DrawScore();
+    // LMR 2: MARGINAL REDUCTION OF BAD CAPTURES
+
+    if (depth > 2
+    && Par.searchSkill > 8
+    && movesTried > 6
+    && !n->flagInCheck
+    && !p->InCheck()
+    && (moveType == MV_BADCAPT)
+    && !n->isPv) {
+        reduction = 1;
+        newDepth -= reduction;
     }
 
-    // SAVE RESULT IN THE TRANSPOSITION TABLE
+#ifdef USE_THREADS
+    if (n->markBusy) {
+        if (IsBusy(busyTag))
+            mSmpStats.duplicated++;
+        BusySlot(busyTag).store(busyTag, std::memory_order_relaxed);
+        mSmpStats.marked++;
+    }
+#endif
 
-    if (*pv) {
-        if (!flagInCheck) {
-            UpdateHistory(p, lastMove, *pv, depth, ply);
-            for (int mv = 0; mv < movesTried; mv++) {
-                DecreaseHistory(p, movesPlayed[mv], depth);
-            }
-        }
-        Trans.Store(p->mHashKey, *pv, best, EXACT, depth, ply);
-    } else
-        Trans.Store(p->mHashKey, 0, best, UPPER, depth, ply);
+research:
 
-    return best;
+    // PRINCIPAL VARIATION SEARCH
+
+    if (first)
+        *score = -Search(p, ply + 1, -beta, -alpha, newDepth, false, move, lastCaptTarget, newPv);
+    else {
+        *score = -Search(p, ply + 1, -alpha - 1, -alpha, newDepth, false, move, lastCaptTarget, newPv);
+        if (!Glob.abortSearch && *score > alpha && *score < beta)
+            *score = -Search(p, ply + 1, -beta, -alpha, newDepth, false, move, lastCaptTarget, newPv);
+    }
+
+    // DON'T REDUCE A MOVE THAT SCORED ABOVE ALPHA
+
+    if (*score > alpha && reduction) {
+        newDepth = newDepth + reduction;
+        reduction = 0;
+        goto research;
+    }
+
+    // UNDO MOVE
+
+    p->UndoMove(move, u);
+
+#ifdef USE_THREADS
+    if (n->markBusy && IsBusy(busyTag))
+        BusySlot(busyTag).store(0, std::memory_order_relaxed);
+#endif
+
+    return true;
 }
 
 int cEngine::SetLateMoveReduction(bool isPv, int depth, int movesTried, int moveHistScore, bool improving) {
     
-    return (int)msLmrSize[isPv][depth][movesTried]  // read reduction amount from the table
+    return (int)msLmrSize[mProfile][isPv][depth][movesTried]  // read reduction amount from the table
          + (moveHistScore < 0)                      // increase if history score is bad
          + (!isPv && moveHistScore < -MAX_HIST / 2) // in two steps
          + (!isPv && !improving);                   // increase if score is going down
 }
 
 bool cEngine::ShouldAbortSearch() {
+
+#ifdef USE_THREADS
+    for (sSplitPoint *sp = mSplit; sp; sp = sp->parent)     // someone found a cutoff above us
+        if (sp->cutoff.load(std::memory_order_relaxed))
+            return true;
+#endif
+
     return (Glob.abortSearch && mRootDepth > 1);
 }
 
@@ -1217,10 +1552,56 @@ int cEngine::SetNullReductionDepth(int depth, int eval, int beta) {
                 // - Min(3, (eval - beta) / 200);
 }
 
+sSmpStats cEngine::SumSmpStats() {
+
+    sSmpStats sum = {};
+
+#ifdef USE_THREADS
+    for (auto& engine: Engines) {
+        sum.marked += engine.mSmpStats.marked;
+        sum.duplicated += engine.mSmpStats.duplicated;
+        sum.deferred += engine.mSmpStats.deferred;
+    }
+#endif
+
+    return sum;
+}
+
+// Each thread counts its nodes in its own cEngine, so that the counter
+// does not bounce between cores. The total is summed only when needed
+// and kept in Glob.nodes, which is otherwise left alone by the search.
+
+U64 cEngine::SumNodes() {
+
+    U64 nodes = 0;
+
+#ifdef USE_THREADS
+    for (auto& engine: Engines)
+        nodes += engine.mNodes.load(std::memory_order_relaxed);
+#else
+    nodes = EngineSingle.mNodes;
+#endif
+
+    Glob.nodes = nodes;
+    return nodes;
+}
+
+void cEngine::ClearNodes() {
+
+#ifdef USE_THREADS
+    for (auto& engine: Engines)
+        engine.mNodes = 0;
+#else
+    EngineSingle.mNodes = 0;
+#endif
+
+    Glob.nodes = 0;
+}
+
 U64 GetNps(int elapsed) {
 
     if (elapsed) {
-        return (Glob.nodes * 1000) / elapsed;
+        return (cEngine::SumNodes() * 1000) / elapsed;
     }
     return 0;
 }
@@ -1251,7 +1632,8 @@ void cEngine::DisplayPvDepth(int depth, int multipv, int score, int *pv) {
     const char *type; 
     char pvString[512];
     int elapsed = GetMS() - msStartTime;
-    U64 nps = GetNps(elapsed);
+    U64 nodes = SumNodes();
+    U64 nps = elapsed ? nodes * 1000 / elapsed : 0;
 
     type = "mate";
     if (score < -MAX_EVAL)
@@ -1264,11 +1646,11 @@ void cEngine::DisplayPvDepth(int depth, int multipv, int score, int *pv) {
     PvToStr(pv, pvString);
 
     if (multipv == 0)
-        printfUciOut("info depth %d time %d nodes %" PRIu64 " nps %" PRIu64 " score %s %d pv %s\n",
-                depth, elapsed, (U64)Glob.nodes, nps, type, score, pvString);
+        printfUciOut("info depth %d time %d nodes %" PRIu64 " nps %" PRIu64 " hashfull %d score %s %d pv %s\n",
+                depth, elapsed, nodes, nps, Trans.HashFull(), type, score, pvString);
     else
-        printfUciOut("info depth %d multipv %d time %d nodes %" PRIu64 " nps %" PRIu64 " score %s %d pv %s\n",
-                depth, multipv, elapsed, (U64)Glob.nodes, nps, type, score, pvString);
+        printfUciOut("info depth %d multipv %d time %d nodes %" PRIu64 " nps %" PRIu64 " hashfull %d score %s %d pv %s\n",
+                depth, multipv, elapsed, nodes, nps, Trans.HashFull(), type, score, pvString);
 }
 
 void CheckTimeout() {
@@ -1276,23 +1658,7 @@ void CheckTimeout() {
     if (Glob.abortSearch)
         return; // must handle "stop" first!
 
-    char command[80];
-
-    if (InputAvailable()) {
-        ReadLine(command, sizeof(command));
-        if (strcmp(command, "stop") == 0)
-            Glob.abortSearch = true;
-        else if (strcmp(command, "quit") == 0) {
-#ifndef USE_THREADS
-            exit(0);
-#else
-            Glob.abortSearch = true;
-            Glob.goodbye = true; // will crash if just `exit()`. should wait until threads are terminated
-#endif
-        }
-        else if (strcmp(command, "ponderhit") == 0)
-            Glob.pondering = false;
-    }
+    HandleSearchInput();
 
     if (!Glob.pondering && !Glob.infinite && cEngine::msMoveTime >= 0 && GetMS() - cEngine::msStartTime >= cEngine::msMoveTime)
         Glob.abortSearch = true;
@@ -1300,10 +1666,12 @@ void CheckTimeout() {
 
 void cEngine::Slowdown() {
 
-    // Handling search limited by the number of nodes
+    // Handling search limited by the number of nodes. The other threads
+    // are summed only every 256 nodes, so a single thread stops exactly.
 
     if (msMoveNodes > 0) {
-        if (Glob.nodes >= (unsigned)msMoveNodes)
+        if (mNodes >= (unsigned)msMoveNodes
+        || (!(mNodes & 255) && SumNodes() >= (unsigned)msMoveNodes))
             Glob.abortSearch = true;
     }
 
@@ -1337,17 +1705,11 @@ void cEngine::Slowdown() {
 	}
 #endif
 
-    // for MultiPv
-
-    if (Glob.multiPv > 1) {
-        if (TimeTestIntervalReached() ) CheckTimeout();
-    }
-
 }
 
 bool cEngine::TimeTestIntervalReached() {
 
-    return ((!(Glob.nodes & 2047))
+    return ((!(mNodes & 2047))
         && !Glob.isTesting
         && !Glob.isBenching
         &&  mRootDepth > 1);
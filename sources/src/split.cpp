@@ -0,0 +1,260 @@
+/*
+Rodent, a UCI chess playing engine derived from Sungorus 1.4
+Copyright (C) 2009-2011 Pablo Vazquez (Sungorus author)
+Copyright (C) 2011-2019 Pawel Koziol
+Copyright (C) 2020-2020 Bernhard C. Maerz
+
+Rodent is free software: you can redistribute it and/or modify it under the terms of the GNU
+General Public License as published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+Rodent is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with this program.
+If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Young Brothers Wait Concept, the alternative to Lazy SMP. Only the first
+// engine thinks; the others wait in HelpSplits() until a node has searched
+// its first move and offers the rest of its move list as a split point.
+
+#include "rodent.h"
+#include <cstring>
+
+#ifdef USE_THREADS
+
+#include <vector>
+
+static std::mutex poolMutex;                // guards everything below but idleHelpers
+static std::condition_variable poolWake;
+static std::vector<sSplitPoint *> openSplits;
+static std::atomic<int> idleHelpers(0);
+static bool searchOver;
+
+// The split point that offers the most work, i.e. the one closest to the root
+
+static sSplitPoint *BestSplit() {
+
+    sSplitPoint *best = NULL;
+
+    for (sSplitPoint *sp: openSplits)
+        if (!sp->cutoff && (!best || sp->node->depth > best->node->depth))
+            best = sp;
+
+    return best;
+}
+
+// Takes a split point out of the pool once its move list has run out or a
+// thread has failed high there, so that idle helpers stop joining it and go
+// to split points that still have work. Does nothing if it is gone already.
+
+static void CloseSplit(sSplitPoint *sp) {
+
+    std::lock_guard<std::mutex> lock(poolMutex);
+
+    for (size_t i = 0; i < openSplits.size(); i++)
+        if (openSplits[i] == sp) {
+            openSplits.erase(openSplits.begin() + i);
+            break;
+        }
+}
+
+bool cEngine::CanSplit(int depth) {
+
+    return Glob.smpMode == SMP_YBWC
+        && depth >= mscSplitDepth
+        && idleHelpers.load(std::memory_order_relaxed) > 0
+        && !ShouldAbortSearch();
+}
+
+// Called by Search() after the first move of a node has been searched.
+// The owner searches the remaining moves together with the helpers that
+// join, waits until the last of them leaves and returns the best score,
+// move and pv found at the split point.
+//
+// The owner takes the rest of its move list out before the split point is
+// published. Ordering the quiet moves reads its history, which it goes on
+// updating in the nodes below, so helpers must not call NextMove() on its
+// list; they only take moves from the split point.
+
+void cEngine::Split(POS *p, MOVES *m, sNodeInfo *n, int alpha, int beta, int *best, int *bestMove, int *pv) {
+
+    sSplitPoint sp;
+    int move, moveType;
+
+    sp.moveCount = 0;
+    while ((move = NextMove(m, &moveType, n->ply)))
+        sp.moves[sp.moveCount++] = move | moveType << 16;
+
+    if (sp.moveCount == 0)
+        return;
+
+    sp.nextMove = 0;
+    sp.pos = *p;
+    sp.node = n;
+    sp.parent = mSplit;
+    sp.alpha = alpha;
+    sp.beta = beta;
+    sp.best = *best;
+    sp.bestMove = 0;
+    sp.pv[0] = 0;
+    for (int i = 0; i < MAX_PLY; i++)
+        sp.evalStack[i] = mStack[i].eval;
+    sp.rootDepth = mRootDepth;
+    sp.workers = 0;
+    sp.cutoff = false;
+
+    n->split = &sp;
+
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        openSplits.push_back(&sp);
+    }
+    poolWake.notify_all();
+
+    mSplit = &sp;
+    SearchSplit(&sp);
+    mSplit = sp.parent;
+
+    CloseSplit(&sp);
+    {
+        std::unique_lock<std::mutex> lock(poolMutex);
+        poolWake.wait(lock, [&sp] { return sp.workers == 0; });
+    }
+
+    n->split = NULL;
+
+    if (sp.best > *best) {
+        *best = sp.best;
+        if (sp.bestMove) {
+            *bestMove = sp.bestMove;
+            for (int i = 0; (pv[i] = sp.pv[i]); i++)
+                ;
+        }
+    }
+}
+
+// Takes moves of a split point one at a time until there are none left,
+// a thread fails high or the search is stopped. Every move is searched
+// with a null window first, against the best alpha known so far.
+
+void cEngine::SearchSplit(sSplitPoint *sp) {
+
+    POS p[1];
+    sNodeInfo *n = sp->node;
+    int move, moveType, alpha, score;
+    int *newPv = mStack[n->ply + 1].pv;
+
+    *p = sp->pos;
+
+    for (;;) {
+        sp->lock.lock();
+        if (!sp->cutoff && sp->nextMove < sp->moveCount) {
+            move = sp->moves[sp->nextMove] & 0xFFFF;
+            moveType = sp->moves[sp->nextMove++] >> 16;
+        } else
+            move = 0;
+        alpha = sp->alpha;
+        sp->lock.unlock();
+
+        if (!move) {
+            CloseSplit(sp);
+            break;
+        }
+
+        if (!SearchMove(p, n, move, moveType, alpha, sp->beta, false, &score, newPv))
+            continue;
+
+        if (ShouldAbortSearch())
+            break;
+
+        std::lock_guard<std::mutex> lock(sp->lock);
+        if (score > sp->best) {
+            sp->best = score;
+            if (score > sp->alpha) {
+                sp->alpha = score;
+                sp->bestMove = move;
+                BuildPv(sp->pv, newPv, move);
+            }
+            if (score >= sp->beta) {
+                sp->cutoff = true;
+                break;
+            }
+        }
+    }
+
+    if (sp->cutoff)
+        CloseSplit(sp);
+}
+
+// Loop of an engine that does not think itself: join the best open split
+// point, search there, and wait for the next one until the search is over
+
+void cEngine::HelpSplits() {
+
+    Trans.SetThread(mcThreadId);
+    mProfile = 0;
+    mSmpStats = {};
+
+    std::unique_lock<std::mutex> lock(poolMutex);
+
+    for (;;) {
+        sSplitPoint *sp = NULL;
+
+        idleHelpers++;
+        poolWake.wait(lock, [&sp] { return searchOver || (sp = BestSplit()) != NULL; });
+        idleHelpers--;
+        if (searchOver)
+            return;
+
+        sp->workers++;
+        lock.unlock();
+
+        for (int i = 0; i < MAX_PLY; i++)
+            mStack[i].eval = sp->evalStack[i];
+        mRootDepth = sp->rootDepth;
+        mSplit = sp;
+        SearchSplit(sp);
+        mSplit = NULL;
+
+        lock.lock();
+        sp->workers--;
+        poolWake.notify_all();
+    }
+}
+
+// Starts a search with all engines: each thinks on its own in Lazy SMP
+// mode, while with YBWC the first one thinks and the rest help it
+
+void StartEngines(POS *p) {
+
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        searchOver = false;
+    }
+
+    for (auto& engine: Engines) {
+        if (Glob.smpMode == SMP_YBWC && &engine != &Engines.front())
+            engine.StartHelpThread(p);
+        else
+            engine.StartThinkThread(p); // mDpCompleted cleared in StartThinkThread();
+    }
+}
+
+void WaitEngines() {
+
+    Engines.front().WaitThinkThread();
+
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        searchOver = true;
+    }
+    poolWake.notify_all();
+
+    for (auto& engine: Engines)
+        engine.WaitThinkThread();
+}
+
+#endif
@@ -20,145 +20,458 @@ If not, see <http://www.gnu.org/licenses/>.
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#if !defined(_WIN32)
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <cerrno>
+#endif
 
-#if defined(USE_THREADS)
-    #include <atomic>
-    #include <memory>
+// There are no locks around the transposition table. Each entry keeps part
+// of its key xor-ed with its data (see ENTRY), and all reads work on a private
+// copy of the entry, which is verified before use. A race between two writers
+// or a writer and a reader can only make an entry look like a miss.
 
-    // TODO: see if we get a slowdown by making all these class methods
+ChessHeapClass Trans;
+thread_local int ChessHeapClass::msThread = 0;
+
+static const char *backingName[] = { "regular pages", "huge pages (MAP_HUGETLB)", "transparent huge pages (madvise)", "hash file (mmap)", "shared memory (shm_open)" };
+
+// A hash file starts with this header, followed by the clusters as they are
+// in memory. The header takes the space of one cluster, so that clusters of
+// a mapped file stay aligned to the cache line. Bump the version whenever
+// ENTRY or the way it is verified changes.
+
+struct TTFILEHEADER {
+    char     magic[8];
+    uint32_t version;
+    uint32_t clusterBytes;
+    uint32_t clusterEntries;
+    uint32_t sizeMb;
+    U64      clusters;
+    U64      zobrist;       // POS::ZobristSignature() of the build that saved it
+    uint32_t date;
+    uint32_t salt;
+    char     padding[16];
+};
+
+static_assert(sizeof(TTFILEHEADER) == sizeof(CLUSTER), "TTFILEHEADER must take one cluster.");
 
-    std::unique_ptr<std::atomic_flag[]> aflags0;
-    std::unique_ptr<std::atomic_flag[]> aflags1;
-    const unsigned int elem_per_aflag = 4;
+void ChessHeapClass::AllocTrans(unsigned int mbsize) {
 
-    #define LOCK_ME_PLEASE0   const unsigned int current_aflag = (key & tt_mask) / elem_per_aflag; while (aflags0[current_aflag].test_and_set(std::memory_order_acquire));
-    #define UNLOCK_ME_PLEASE0 aflags0[current_aflag].clear(std::memory_order_release)
-    #define LOCK_ME_PLEASE1   const unsigned int current_aflag = (key & tt_mask) / elem_per_aflag; while (aflags1[current_aflag].test_and_set(std::memory_order_acquire));
-    #define UNLOCK_ME_PLEASE1 aflags1[current_aflag].clear(std::memory_order_release)
+    // any size will do, the index is not taken with a mask
 
-    #define LOCK_ME_PLEASE01   const unsigned int current_aflag = (key & tt_mask) / elem_per_aflag;\
-                               while (aflags0[current_aflag].test_and_set(std::memory_order_acquire));\
-                               while (aflags1[current_aflag].test_and_set(std::memory_order_acquire));
+    if (mbsize < 1) mbsize = 1;
+    if (mbsize > (unsigned int)max_tt_size_mb) mbsize = max_tt_size_mb;
 
-#else
-    #define LOCK_ME_PLEASE0
-    #define UNLOCK_ME_PLEASE0
-    #define LOCK_ME_PLEASE1
-    #define UNLOCK_ME_PLEASE1
+    if (shared && tt_mb != mbsize) {
+        printfUciOut("info string hash is shared, its size is set by the segment\n");
+        return;
+    }
 
-    #define LOCK_ME_PLEASE01
+    if (tt_mb != mbsize) { // don't waste time if the size is the same
 
-#endif
+        // keep the contents if there is room for the old and the new table
+        // at the same time, otherwise start again with an empty one
 
-ChessHeapClass Trans;
+        if (!success || !Resize(mbsize)) {
 
-void ChessHeapClass::AllocTrans(unsigned int mbsize) {
+            if (!Alloc(mbsize)) {
+                if (Glob.isNoisy)
+                    printfUciOut("info string memory allocation error\n");
+                tt_mb = 0; // will realloc next time
+                return;
+            }
 
-    static unsigned int prev_size;
+            tt_size = (U64)mbsize * (1024 * 1024 / sizeof(CLUSTER)); // number of elements of type CLUSTER
+            tt_date = 0;
+            tt_salt = 0;
 
-    for (tt_size = 2; tt_size <= mbsize; tt_size *= 2)
-        ;
+            // anonymous mappings come from the kernel already zeroed
 
-    tt_size /= 2;
+            if (backing == TT_MALLOC)
+                ZeroMem();
+        }
 
-    if (prev_size != tt_size) { // don't waste time if the size is the same
+        tt_mb = mbsize;
+    } else
+        Clear();
 
-        if (!Alloc(tt_size)) {
-            if (Glob.isNoisy)
-                printfUciOut("info string memory allocation error\n");
-            prev_size = 0; // will realloc next time
-            return;
-        }
+    if (Glob.isNoisy) {
+        printfUciOut("info string %uMB of memory allocated\n", tt_mb);
+        PrintBacking();
+    }
+}
+
+// Answers "uci" as well, so that the backing can be checked in deployment
+// without turning on Verbose
+
+void ChessHeapClass::PrintBacking() const {
+
+    printfUciOut("info string hash %uMB backed by %s\n", tt_mb, backingName[backing]);
+}
 
-        prev_size = tt_size;
+// On Linux, back the whole table with a single huge page region: explicit
+// huge pages if the system has reserved some, otherwise a 2MB-aligned
+// mapping advised to use transparent huge pages. Fewer TLB misses on probes
+// make a clear difference with big hash sizes. Returns false if neither
+// works, so that the caller can fall back to ordinary malloc'd buckets.
 
-        tt_size = tt_size * (1024 * 1024 / sizeof(ENTRY)); // number of elements of type ENTRY
-        tt_mask = tt_size - 4;
-        //printfUciOut("info string ttsize %ull\n", tt_size);
+bool ChessHeapClass::AllocHuge(int size_mb) {
 
-#if defined(USE_THREADS)
-        unsigned int number_of_aflags = tt_size / 4;
+#if defined(__linux__)
+    const size_t page = 2 * 1024 * 1024;
+    const size_t size = ((size_t)size_mb * 1024 * 1024 + page - 1) & ~(page - 1);
+    void *mem = MAP_FAILED;
 
-        aflags0 = std::make_unique<std::atomic_flag[]> (number_of_aflags);
-        aflags1 = std::make_unique<std::atomic_flag[]> (number_of_aflags);
+#ifdef MAP_HUGETLB
+    mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (mem != MAP_FAILED)
+        backing = TT_HUGETLB;
+#endif
+
+#ifdef MADV_HUGEPAGE
+    if (mem == MAP_FAILED) {
+
+        // over-allocate, then trim the region to 2MB boundaries
+
+        char *raw = (char *)mmap(NULL, size + page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED)
+            return false;
+
+        char *aligned = (char *)(((uintptr_t)raw + page - 1) & ~(uintptr_t)(page - 1));
+        if (aligned > raw)
+            munmap(raw, aligned - raw);
+        munmap(aligned + size, raw + page - aligned);
 
-        for (unsigned int i = 0; i < number_of_aflags; i++) {
-            aflags0[i].clear(std::memory_order_relaxed);
-            aflags1[i].clear(std::memory_order_relaxed);
+        if (madvise(aligned, size, MADV_HUGEPAGE) != 0) {
+            munmap(aligned, size);
+            return false;
         }
+
+        mem = aligned;
+        backing = TT_THP;
+    }
 #endif
+
+    if (mem == MAP_FAILED)
+        return false;
+
+    huge_mem = mem;
+    huge_size = size;
+
+    for (int i = 0; size_mb > 0; i++) {
+        bucket_sizs[i] = size_mb > bucket_size_mb ? bucket_size_mb : size_mb;
+        bucket_ptrs[i] = (CLUSTER *)((char *)mem + (size_t)i * bucket_size_mb * 1024 * 1024);
+        size_mb -= bucket_size_mb;
     }
 
-    Clear();
+    printf_debug("allocated: %dMB of huge pages\n", (int)(size / (1024 * 1024)));
+    return true;
+#else
+    (void)size_mb;
+    return false;
+#endif
+}
+
+void ChessHeapClass::FreeHuge() {
+
+#if !defined(_WIN32)
+    munmap(huge_mem, huge_size);
+#endif
+
+    huge_mem = NULL;
+    huge_size = 0;
 
-    if (Glob.isNoisy)
-        printfUciOut("info string %uMB of memory allocated\n", prev_size);
+    for (int i = 0; i < arrays_size; i++)
+        bucket_ptrs[i] = NULL;
 }
 
+// A shared table has one date for all processes using it.
+
+void ChessHeapClass::NewSearch() {
+
+    std::fill(stats.begin(), stats.end(), TTSTATS()); // statistics are kept for one search
+
+#if !defined(_WIN32)
+    if (shared) {
+        tt_date = __atomic_add_fetch(&shared->date, 1, __ATOMIC_RELAXED) & 63;
+        return;
+    }
+#endif
+
+    tt_date = (tt_date + 1) & 63;
+}
+
+// Clearing the table does not touch its memory. A new salt is mixed into
+// the stored keys, so that entries from before the clear no longer match any
+// position. Jumping half the date range ahead makes them look old, but they
+// keep their dates and still take part in replacement (two clears later they
+// look young again), and they count in HashFull(). Good enough for
+// ucinewgame and "Clear Hash"; see Reset() for a table that must be empty.
+
 void ChessHeapClass::Clear() {
 
-    tt_date = 0;
+    if (shared) return; // other processes still use it
+
+    tt_salt += 0x9E3779B9;
+    tt_date = (tt_date + 32) & 63;
+}
+
+// Zeroes the table for real, so that bench and the Texel tuner start from
+// the same state every time and their results can be reproduced
+
+void ChessHeapClass::Reset() {
+
+    if (shared) return;
 
     ZeroMem();
+    tt_salt = 0;
+    tt_date = 0;
 }
 
-bool ChessHeapClass::Retrieve(U64 key, int *move, int *score, int *flag, int alpha, int beta, int depth, int ply) {
+// Run work(from, to) over [0, count), split into equal slices, one for each
+// hardware thread.
 
-    if (!success) return false;
+template <typename F>
+static void ParallelFor(U64 count, F work) {
+
+#ifdef USE_THREADS
+    const U64 threads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::thread> workers;
+
+    for (U64 i = 1; i < threads; i++)
+        workers.emplace_back(work, count * i / threads, count * (i + 1) / threads);
+    work(0, count / threads);
+    for (auto &worker : workers)
+        worker.join();
+#else
+    work(0, count);
+#endif
+}
+
+void ChessHeapClass::ZeroMem() {
+
+    if (!success) return;
+
+    // each thread clears its own slice of clusters, bucket by bucket
+
+    ParallelFor(tt_size, [this](U64 from, U64 to) {
+        while (from < to) {
+            const U64 len = std::min(to - from, num_per_bucket - from % num_per_bucket);
+            memset(MakeAddr(from), 0, (size_t)len * sizeof(CLUSTER));
+            from += len;
+        }
+    });
+}
+
+// floor(a * b / c) and the remainder, without 128-bit arithmetic
+
+static void MulDiv(U64 a, U64 b, U64 c, U64 *quot, U64 *rem) {
 
-    ENTRY *entry = MakeAddr(key & tt_mask);
-
-    LOCK_ME_PLEASE0;
-
-    for (int i = 0; i < 4; i++) {
-        if (entry->key == key) {
-            entry->date = tt_date;
-            *move = entry->move;
-            if (entry->depth >= depth) {
-				*flag = entry->flags;
-                *score = entry->score;
-                if (*score < -MAX_EVAL)
-                    *score += ply;
-                else if (*score > MAX_EVAL)
-                    *score -= ply;
-                if ((entry->flags & UPPER && *score <= alpha)
-                || (entry->flags & LOWER && *score >= beta)) {
-                    //entry->date = tt_date; // refreshing entry TODO: test at 4 threads, at 1 thread it's a wash
-
-                    UNLOCK_ME_PLEASE0;
-                    return true;
+    const U64 bq = b / c, br = b % c;
+    U64 q = 0, r = 0;
+
+    for (int bit = 63; bit >= 0; bit--) {
+        q *= 2; r *= 2;
+        if (r >= c) { r -= c; q++; }
+        if (a >> bit & 1) {
+            q += bq; r += br;
+            if (r >= c) { r -= c; q++; }
+        }
+    }
+
+    *quot = q;
+    *rem = r;
+}
+
+// Move the contents of the table to a newly allocated one of mbsize
+// megabytes. Returns false, leaving the table as it is, if there is not
+// enough memory for both of them.
+
+bool ChessHeapClass::Resize(unsigned int mbsize) {
+
+    ChessHeapClass *next = new ChessHeapClass;
+
+    if (!next->Alloc(mbsize)) {
+        delete next;
+        return false;
+    }
+
+    next->tt_size = (U64)mbsize * (1024 * 1024 / sizeof(CLUSTER));
+    next->tt_mb = mbsize;
+    next->tt_date = tt_date;
+    next->tt_salt = tt_salt;
+
+    const U64 migrated = next->Rehash(*this);
+
+    Swap(*next);
+    delete next; // releases the old table
+    printfUciOut("info string hash resized, %" PRIu64 " entries migrated\n", migrated);
+    return true;
+}
+
+// Fill every cluster of this table from the old one. The entries do not
+// keep their full key, so the new cluster of an entry is unknown. It is
+// only known to lie in a range of clusters: multiply-shift indexing is
+// monotonic, so old cluster i covers [i * N'/N, (i + 1) * N'/N) of the new
+// table of N' clusters. Conversely, new cluster j takes its entries from
+// old clusters [j * N/N', (j + 1) * N/N'), keeping the deepest ones. Each
+// thread writes its own slice of new clusters, so no locking is needed.
+// When the table grows, an entry is copied into every cluster of its range
+// but is counted only in the first one. Returns the number of entries
+// migrated.
+
+U64 ChessHeapClass::Rehash(const ChessHeapClass &old) {
+
+    std::atomic<U64> migrated(0);
+
+    ParallelFor(tt_size, [this, &old, &migrated](U64 from, U64 to) {
+
+        const U64 stepQuot = old.tt_size / tt_size, stepRem = old.tt_size % tt_size;
+        U64 first, firstRem, count = 0;
+
+        // very old entries, including all from before the last Clear(), go last
+
+        auto Worth = [this](const ENTRY &e) {
+            return (((tt_date - e.Date()) & 63) < 32 ? 256 : 0) + e.depth;
+        };
+
+        MulDiv(from, old.tt_size, tt_size, &first, &firstRem);
+
+        for (U64 j = from; j < to; j++) {
+
+            // old clusters [first, last] may hold entries of cluster j
+
+            U64 next = first + stepQuot, nextRem = firstRem + stepRem;
+            if (nextRem >= tt_size) { nextRem -= tt_size; next++; }
+            const U64 last = std::min(nextRem ? next : next - 1, old.tt_size - 1);
+
+            CLUSTER fresh = {};
+            bool counts[CLUSTER_SIZE] = {};
+            int used = 0;
+
+            for (U64 i = first; i <= last; i++) {
+                const ENTRY *entry = old.MakeAddr(i)->entry;
+                const bool firstOfRange = i > first || firstRem == 0; // i * N'/N >= j
+                for (int k = 0; k < CLUSTER_SIZE; k++) {
+                    const ENTRY snap = entry[k];
+                    if (IsEmpty(snap))
+                        continue;
+
+                    // insertion into the entries kept so far, best first
+
+                    int pos = used < CLUSTER_SIZE ? used++ : CLUSTER_SIZE;
+                    while (pos > 0 && Worth(fresh.entry[pos - 1]) < Worth(snap)) {
+                        if (pos < CLUSTER_SIZE) {
+                            fresh.entry[pos] = fresh.entry[pos - 1];
+                            counts[pos] = counts[pos - 1];
+                        }
+                        pos--;
+                    }
+                    if (pos < CLUSTER_SIZE) {
+                        fresh.entry[pos] = snap;
+                        counts[pos] = firstOfRange;
+                    }
                 }
             }
-            break;
+
+            *MakeAddr(j) = fresh;
+            for (int k = 0; k < used; k++)
+                count += counts[k];
+            first = next; firstRem = nextRem;
         }
-        entry++;
-    }
 
-    UNLOCK_ME_PLEASE0;
-    return false;
+        migrated += count;
+    });
+
+    return migrated;
 }
 
-void ChessHeapClass::RetrieveMove(U64 key, int *move) {
+void ChessHeapClass::Swap(ChessHeapClass &other) {
+
+    std::swap(bucket_sizs, other.bucket_sizs);
+    std::swap(bucket_mems, other.bucket_mems);
+    std::swap(bucket_ptrs, other.bucket_ptrs);
+    std::swap(huge_mem, other.huge_mem);
+    std::swap(huge_size, other.huge_size);
+    std::swap(shared, other.shared);
+    std::swap(tt_size, other.tt_size);
+    std::swap(tt_mb, other.tt_mb);
+    std::swap(tt_salt, other.tt_salt);
+    std::swap(tt_date, other.tt_date);
+    std::swap(success, other.success);
+    std::swap(backing, other.backing);
+}
 
-    if (!success) return;
+// Look the position up once and return a copy of its entry, so that the
+// search can take all its decisions about the node from that one copy.
 
-    ENTRY *entry = MakeAddr(key & tt_mask);
+bool ChessHeapClass::Probe(U64 key, int ply, TTPROBE *hit) {
 
-    LOCK_ME_PLEASE1;
+    hit->found = false;
+    hit->move = 0;
+    hit->eval = NO_EVAL;
 
-    for (int i = 0; i < 4; i++) {
-        if (entry->key == key) {
-            entry->date = tt_date; // TODO: test without this line (very low priority, long test)
-            *move = entry->move;
-            break;
+    if (!success) return false;
+
+    TTSTATS &st = stats[msThread];
+    ENTRY *entry = Cluster(key)->entry;
+
+    st.probes++;
+
+    for (int i = 0; i < CLUSTER_SIZE; i++, entry++) {
+        ENTRY snap = *entry;
+        if (IsKey(snap, key)) {
+            st.hits++;
+            hit->found = true;
+            hit->move = snap.move;
+            hit->score = snap.score;
+            if (hit->score < -MAX_EVAL)
+                hit->score += ply;
+            else if (hit->score > MAX_EVAL)
+                hit->score -= ply;
+            hit->flags = snap.Flags();
+            hit->depth = snap.depth;
+            hit->eval = snap.eval;
+            hit->age = (tt_date - snap.Date()) & 63;
+            Refresh(entry, snap, key);
+            return true;
         }
-        entry++;
     }
 
-    UNLOCK_ME_PLEASE1;
+    return false;
 }
 
-void ChessHeapClass::Store(U64 key, int move, int score, int flags, int depth, int ply) {
+bool ChessHeapClass::Retrieve(U64 key, int *move, int *score, int *flag, int alpha, int beta, int depth, int ply) {
+
+    TTPROBE hit;
+
+    if (!Probe(key, ply, &hit)) return false;
+
+    *move = hit.move;
+    if (hit.depth >= depth) {
+        *flag = hit.flags;
+        *score = hit.score;
+    }
+
+    return Cutoff(hit, alpha, beta, depth);
+}
+
+void ChessHeapClass::RetrieveMove(U64 key, int *move) {
+
+    TTPROBE hit;
+
+    if (Probe(key, 0, &hit)) // TODO: test without refreshing the entry here (very low priority, long test)
+        *move = hit.move;
+}
+
+void ChessHeapClass::Store(U64 key, int move, int score, int flags, int depth, int ply, int eval) {
 
     if (!success) return;
 
@@ -169,27 +482,497 @@ void ChessHeapClass::Store(U64 key, int move, int score, int flags, int depth, i
     else if (score > MAX_EVAL)
         score += ply;
 
-    ENTRY *entry = MakeAddr(key & tt_mask), *replace = NULL;
+    TTSTATS &st = stats[msThread];
+    ENTRY *entry = Cluster(key)->entry, *replace = NULL;
+    ENTRY victim;
+    bool same = false;
 
-    for (int i = 0; i < 4; i++) {
-        if (entry->key == key) {
-            if (!move) move = entry->move;
+    for (int i = 0; i < CLUSTER_SIZE; i++, entry++) {
+        ENTRY snap = *entry;
+        if (IsKey(snap, key)) {
+            if (!move) move = snap.move;
+            if (eval == NO_EVAL) eval = snap.eval;
             replace = entry;
+            same = true;
             break;
         }
-        age = ((tt_date - entry->date) & 255) * 256 + 255 - entry->depth;
+        age = ((tt_date - snap.Date()) & 63) * 256 + 255 - snap.depth;
         if (age > oldest) {
             oldest = age;
             replace = entry;
+            victim = snap;
         }
-        entry++;
     }
 
-    LOCK_ME_PLEASE01;
+    st.stores++;
+    if (same)                         st.storeSame++;
+    else if (IsEmpty(victim))         st.storeEmpty++;
+    else if (victim.Date() == tt_date) st.storeCurrent++;
+    else                              st.storeOlder++;
+
+    ENTRY fresh;
+
+    fresh.move = move; fresh.score = score; fresh.eval = eval;
+    fresh.dateFlags = tt_date << 2 | flags; fresh.depth = depth;
+    fresh.key = Lock(key) ^ fresh.Data();
+
+    *replace = fresh;
+}
+
+// Mark the entry as used in the current search. The entry is rewritten
+// as a whole, so that its checksum stays valid.
 
-    replace->key = key; replace->date = tt_date; replace->move = move;
-    replace->score = score; replace->flags = flags; replace->depth = depth;
+void ChessHeapClass::Refresh(ENTRY *entry, ENTRY snap, U64 key) {
 
-    UNLOCK_ME_PLEASE0;
-    UNLOCK_ME_PLEASE1;
+    if (snap.Date() == tt_date) return;
+
+    snap.dateFlags = tt_date << 2 | snap.Flags();
+    snap.key = Lock(key) ^ snap.Data();
+    *entry = snap;
+}
+
+// Permill of the table used in the current search, as UCI "hashfull"
+// expects. Estimated from the first thousand entries.
+
+int ChessHeapClass::HashFull() const {
+
+    if (!success) return 0;
+
+    const U64 clusters = std::min(tt_size, (U64)(1000 / CLUSTER_SIZE));
+    int used = 0;
+
+    for (U64 i = 0; i < clusters; i++)
+        for (int k = 0; k < CLUSTER_SIZE; k++) {
+            const ENTRY &entry = MakeAddr(i)->entry[k];
+            used += !IsEmpty(entry) && entry.Date() == tt_date;
+        }
+
+    return (int)(used * 1000 / (clusters * CLUSTER_SIZE));
+}
+
+// Console command "ttstats": counters of the last search, summed over all
+// threads, then the age and depth of entries sampled evenly over the table.
+
+void ChessHeapClass::PrintStats() const {
+
+    if (!success) return;
+
+    TTSTATS sum = {};
+
+    for (size_t i = 0; i < stats.size(); i++) {
+        sum.probes       += stats[i].probes;
+        sum.hits         += stats[i].hits;
+        sum.cutoffs      += stats[i].cutoffs;
+        sum.badMoves     += stats[i].badMoves;
+        sum.stores       += stats[i].stores;
+        sum.storeSame    += stats[i].storeSame;
+        sum.storeEmpty   += stats[i].storeEmpty;
+        sum.storeOlder   += stats[i].storeOlder;
+        sum.storeCurrent += stats[i].storeCurrent;
+        sum.evals        += stats[i].evals;
+    }
+
+    auto Percent = [](U64 part, U64 whole) { return whole ? part * 100.0 / whole : 0.0; };
+
+    printf("hash %uMB backed by %s, hashfull %d\n", tt_mb, backingName[backing], HashFull());
+    printf("probes    %12" PRIu64 "\n", sum.probes);
+    printf("hits      %12" PRIu64 " %6.2f%% of probes\n", sum.hits, Percent(sum.hits, sum.probes));
+    printf("cutoffs   %12" PRIu64 " %6.2f%% of probes\n", sum.cutoffs, Percent(sum.cutoffs, sum.probes));
+    printf("bad moves %12" PRIu64 " %6.2f%% of hits\n", sum.badMoves, Percent(sum.badMoves, sum.hits));
+    printf("evals     %12" PRIu64 " %6.2f%% of hits, Evaluate() skipped\n", sum.evals, Percent(sum.evals, sum.hits));
+    printf("stores    %12" PRIu64 "\n", sum.stores);
+    printf("  same position   %6.2f%%\n", Percent(sum.storeSame, sum.stores));
+    printf("  empty slot      %6.2f%%\n", Percent(sum.storeEmpty, sum.stores));
+    printf("  earlier search  %6.2f%%\n", Percent(sum.storeOlder, sum.stores));
+    printf("  this search     %6.2f%%\n", Percent(sum.storeCurrent, sum.stores));
+
+    // sample at most 65536 clusters
+
+    const U64 samples = std::min(tt_size, (U64)65536);
+    const int ageLimits[] = { 0, 1, 2, 3, 7, 15, 63 };
+    const int depthLimits[] = { 0, 2, 4, 8, 12, 16, 24, 255 };
+    U64 ageCount[7] = {}, depthCount[8] = {}, empty = 0;
+
+    for (U64 i = 0; i < samples; i++) {
+        const ENTRY *entry = MakeAddr(i * tt_size / samples)->entry;
+        for (int k = 0; k < CLUSTER_SIZE; k++) {
+            if (IsEmpty(entry[k])) {
+                empty++;
+                continue;
+            }
+            const int age = (tt_date - entry[k].Date()) & 63;
+            int a = 0, d = 0;
+            while (age > ageLimits[a]) a++;
+            while (entry[k].depth > depthLimits[d]) d++;
+            ageCount[a]++;
+            depthCount[d]++;
+        }
+    }
+
+    const U64 total = samples * CLUSTER_SIZE;
+    const char *ageNames[] = { "0", "1", "2", "3", "4-7", "8-15", "16+" };
+    const char *depthNames[] = { "0", "1-2", "3-4", "5-8", "9-12", "13-16", "17-24", "25+" };
+
+    printf("age (searches ago) of %" PRIu64 " sampled entries, %.2f%% empty:\n", total, Percent(empty, total));
+    for (int a = 0; a < 7; a++)
+        printf("  %-6s %6.2f%%\n", ageNames[a], Percent(ageCount[a], total));
+    printf("depth:\n");
+    for (int d = 0; d < 8; d++)
+        printf("  %-6s %6.2f%%\n", depthNames[d], Percent(depthCount[d], total));
+}
+
+// Micro-benchmark of the table alone: stores a stream of random keys, then
+// probes for them, mixed with keys that were never stored. Shows the cost
+// of a probe without the search around it and how many of the stored
+// positions survive in a table of the current size.
+
+void ChessHeapClass::Bench(int millions) {
+
+    if (!success) return;
+    if (millions <= 0) millions = 4;
+
+    const int count = millions * 1000000;
+    U64 stored = UINT64_C(0x9E3779B97F4A7C15), fresh = UINT64_C(0xD1B54A32D192ED03);
+    int move, hits = 0, falseHits = 0;
+
+    auto NextKey = [](U64 &x) { x ^= x >> 12; x ^= x << 25; x ^= x >> 27; return x * UINT64_C(0x2545F4914F6CDD1D); };
+
+    Clear();
+    printf("TT bench started (%d million keys, %llu clusters of %d entries, %d entries per MB): \n",
+           millions, (unsigned long long)tt_size, CLUSTER_SIZE, (int)(1024 * 1024 / sizeof(CLUSTER)) * CLUSTER_SIZE);
+
+    int start = GetMS();
+    for (int i = 0; i < count; i++)
+        Store(NextKey(stored), (i & 0xfff) + 1, 0, EXACT, i & 63, 0, 0);
+    const int storeTime = GetMS() - start + 1;
+
+    stored = UINT64_C(0x9E3779B97F4A7C15);
+    start = GetMS();
+    for (int i = 0; i < count; i++) {
+        move = 0;
+        if (i & 1) {
+            RetrieveMove(NextKey(fresh), &move);
+            falseHits += (move != 0);
+        } else {
+            RetrieveMove(NextKey(stored), &move);
+            NextKey(stored); // sample every other stored key
+            hits += (move != 0);
+        }
+    }
+    const int probeTime = GetMS() - start + 1;
+
+    printf("stores: %d ms, %.1f ns per store\n", storeTime, storeTime * 1000000.0 / count);
+    printf("probes: %d ms, %.1f ns per probe\n", probeTime, probeTime * 1000000.0 / count);
+    printf("stored keys found: %.2f%%, false hits: %d\n", hits * 200.0 / count, falseHits);
+
+    Clear();
+}
+
+static const char ttFileMagic[8] = { 'R', 'o', 'd', 'e', 'n', 't', 'T', 'T' };
+static constexpr uint32_t ttFileVersion = 3;
+
+static void FillHeader(TTFILEHEADER *header, unsigned int sizeMb, U64 clusters, int date, uint32_t salt) {
+
+    memcpy(header->magic, ttFileMagic, sizeof(header->magic));
+    header->clusterBytes = sizeof(CLUSTER);
+    header->clusterEntries = CLUSTER_SIZE;
+    header->sizeMb = sizeMb;
+    header->clusters = clusters;
+    header->zobrist = POS::ZobristSignature();
+    header->date = date;
+    header->salt = salt;
+}
+
+// returns NULL if a table with this header can be used by this build
+
+static const char *CheckHeader(const TTFILEHEADER &header) {
+
+    if (memcmp(header.magic, ttFileMagic, sizeof(header.magic)) != 0)
+        return "not a hash file";
+    if (header.version != ttFileVersion || header.clusterBytes != sizeof(CLUSTER) || header.clusterEntries != CLUSTER_SIZE)
+        return "saved by another version";
+    if (header.zobrist != POS::ZobristSignature())
+        return "saved with other hash keys";
+    if (header.sizeMb < 1 || header.sizeMb > (unsigned int)max_tt_size_mb
+    ||  header.clusters != (U64)header.sizeMb * (1024 * 1024 / sizeof(CLUSTER)))
+        return "bad size";
+    return NULL;
+}
+
+bool ChessHeapClass::Save(const char *fileName) {
+
+    if (!success || !*fileName) return false;
+
+    // write to a temporary file first: the table may be mapped from fileName
+
+    const std::string tmpName = std::string(fileName) + ".tmp";
+    FILE *f = fopen(tmpName.c_str(), "wb");
+
+    if (f == NULL) {
+        printfUciOut("info string cannot write %s\n", tmpName.c_str());
+        return false;
+    }
+
+    TTFILEHEADER header = {};
+
+    FillHeader(&header, tt_mb, tt_size, tt_date, tt_salt);
+    header.version = ttFileVersion;
+
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+
+    for (U64 from = 0; ok && from < tt_size; ) {
+        const U64 len = std::min(tt_size - from, num_per_bucket - from % num_per_bucket);
+        ok = fwrite(MakeAddr(from), sizeof(CLUSTER), (size_t)len, f) == len;
+        from += len;
+    }
+
+    ok = fclose(f) == 0 && ok;
+
+#if defined(_WIN32)
+    if (ok) remove(fileName); // rename() does not replace files on Windows
+#endif
+
+    if (!ok || rename(tmpName.c_str(), fileName) != 0) {
+        remove(tmpName.c_str());
+        printfUciOut("info string cannot write %s\n", fileName);
+        return false;
+    }
+
+    printfUciOut("info string hash %uMB saved to %s\n", tt_mb, fileName);
+    return true;
+}
+
+// Load a hash file saved by Save(). Where possible, the file is mapped
+// rather than read, so even a big table is ready at once and is paged in
+// as the search touches it. Otherwise it is read into a table of its own,
+// which replaces the current one only once the whole file is in. Either
+// way the current table is kept if the file cannot be used. A shared table
+// stays as it is: other processes are using it.
+
+bool ChessHeapClass::Load(const char *fileName) {
+
+    if (!*fileName) return false;
+
+    if (shared) {
+        printfUciOut("info string hash is shared, %s not loaded\n", fileName);
+        return false;
+    }
+
+    FILE *f = fopen(fileName, "rb");
+
+    if (f == NULL) {
+        printfUciOut("info string cannot open %s\n", fileName);
+        return false;
+    }
+
+    TTFILEHEADER header;
+    const char *problem = fread(&header, sizeof(header), 1, f) != 1 ? "not a hash file" : CheckHeader(header);
+
+#if !defined(_WIN32)
+    fclose(f);
+
+    if (problem == NULL && !MapFile(fileName, sizeof(header) + (size_t)header.clusters * sizeof(CLUSTER)))
+        problem = "cannot map it";
+#else
+    if (problem == NULL) {
+        ChessHeapClass *next = new ChessHeapClass;
+
+        if (!next->Alloc(header.sizeMb))
+            problem = "not enough memory";
+        for (U64 from = 0; problem == NULL && from < header.clusters; ) {
+            const U64 len = std::min(header.clusters - from, num_per_bucket - from % num_per_bucket);
+            if (fread(next->MakeAddr(from), sizeof(CLUSTER), (size_t)len, f) != len)
+                problem = "truncated";
+            from += len;
+        }
+
+        if (problem == NULL)
+            Swap(*next);
+        delete next; // releases the old table, or the one that could not be filled
+    }
+
+    fclose(f);
+#endif
+
+    if (problem) {
+        printfUciOut("info string %s: %s\n", fileName, problem);
+        return false;
+    }
+
+    tt_size = header.clusters;
+    tt_mb = header.sizeMb;
+    tt_date = header.date & 63;
+    tt_salt = header.salt;
+
+    printfUciOut("info string hash %uMB loaded from %s\n", tt_mb, fileName);
+    return true;
+}
+
+bool ChessHeapClass::MapFile(const char *fileName, size_t fileSize) {
+
+#if !defined(_WIN32)
+    const int fd = open(fileName, O_RDONLY);
+    struct stat st;
+
+    if (fd < 0)
+        return false;
+
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size != fileSize) {
+        close(fd);
+        return false;
+    }
+
+    // a private mapping: pages the search writes to are copied, the file
+    // itself never changes
+
+    void *mem = mmap(NULL, fileSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (mem == MAP_FAILED)
+        return false;
+
+    Free();
+    UseRegion(mem, fileSize, TT_FILE);
+    return true;
+#else
+    (void)fileName; (void)fileSize;
+    return false;
+#endif
+}
+
+// Take a mapped region, starting with a TTFILEHEADER, as the table
+
+void ChessHeapClass::UseRegion(void *mem, size_t size, eTTBacking how) {
+
+    huge_mem = mem;
+    huge_size = size;
+
+    CLUSTER *clusters = (CLUSTER *)mem + 1; // skip the header
+    int size_mb = (int)((size - sizeof(CLUSTER)) / (1024 * 1024));
+
+    for (int i = 0; size_mb > 0; i++) {
+        bucket_sizs[i] = size_mb > bucket_size_mb ? bucket_size_mb : size_mb;
+        bucket_ptrs[i] = clusters + (U64)i * num_per_bucket;
+        size_mb -= bucket_size_mb;
+    }
+
+    backing = how;
+    success = true;
+}
+
+// Move the table to a named POSIX shared memory segment, so that several
+// engine processes on one host search with one table. The first process
+// creates the segment with its current hash size and copies its entries
+// there; the others attach to it and take its size. Entries are verified
+// without locks, so processes need no more than threads do. The segment
+// outlives the processes, like a file, until it is removed from /dev/shm.
+
+bool ChessHeapClass::Share(const char *name) {
+
+#if !defined(_WIN32)
+    if (!success || !*name) return false;
+
+    const std::string shmName = name[0] == '/' ? std::string(name) : "/" + std::string(name);
+    size_t size = sizeof(TTFILEHEADER) + (size_t)tt_size * sizeof(CLUSTER);
+    bool created = true;
+    const char *problem = NULL;
+    struct stat st;
+
+    int fd = shm_open(shmName.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0 && errno == EEXIST) {
+        created = false;
+        fd = shm_open(shmName.c_str(), O_RDWR, 0600);
+    }
+
+    if (fd < 0) {
+        printfUciOut("info string cannot open shared memory %s\n", shmName.c_str());
+        return false;
+    }
+
+    if (created) {
+        if (ftruncate(fd, size) != 0) {
+            close(fd);
+            shm_unlink(shmName.c_str());
+            printfUciOut("info string cannot create %uMB of shared memory\n", tt_mb);
+            return false;
+        }
+    } else {
+        for (int i = 0; i < 100; i++) { // the creator may still be sizing it
+            if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(TTFILEHEADER))
+                break;
+            usleep(10000);
+        }
+        size = fstat(fd, &st) == 0 ? (size_t)st.st_size : 0;
+    }
+
+    void *mem = size >= sizeof(TTFILEHEADER) ? mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+
+    if (mem == MAP_FAILED) {
+        printfUciOut("info string cannot map shared memory %s\n", shmName.c_str());
+        return false;
+    }
+
+    TTFILEHEADER *header = (TTFILEHEADER *)mem;
+    ChessHeapClass *next = new ChessHeapClass;
+
+    if (created) {
+
+        // version goes last, attaching processes wait for it
+
+        FillHeader(header, tt_mb, tt_size, tt_date, tt_salt);
+        __atomic_store_n(&header->version, ttFileVersion, __ATOMIC_RELEASE);
+    } else {
+        for (int i = 0; i < 100 && __atomic_load_n(&header->version, __ATOMIC_ACQUIRE) == 0; i++)
+            usleep(10000);
+        problem = CheckHeader(*header);
+        if (!problem && size != sizeof(TTFILEHEADER) + (size_t)header->clusters * sizeof(CLUSTER))
+            problem = "bad size";
+    }
+
+    if (problem) {
+        munmap(mem, size);
+        delete next;
+        printfUciOut("info string shared memory %s: %s\n", shmName.c_str(), problem);
+        return false;
+    }
+
+    next->UseRegion(mem, size, TT_SHARED);
+    next->shared = header;
+    next->tt_size = header->clusters;
+    next->tt_mb = header->sizeMb;
+    next->tt_salt = header->salt;
+    next->tt_date = header->date & 63;
+
+    const U64 migrated = created ? next->Rehash(*this) : 0;
+
+    Swap(*next);
+    delete next; // releases the private table
+
+    if (created)
+        printfUciOut("info string hash %uMB moved to shared memory %s, %" PRIu64 " entries migrated\n", tt_mb, shmName.c_str(), migrated);
+    else
+        printfUciOut("info string hash %uMB attached to shared memory %s\n", tt_mb, shmName.c_str());
+    return true;
+#else
+    (void)name;
+    printfUciOut("info string shared hash is not supported on this platform\n");
+    return false;
+#endif
+}
+
+// Go back to a private table, keeping a copy of the shared entries
+
+void ChessHeapClass::Unshare() {
+
+    if (!shared) return;
+
+    const unsigned int mbsize = tt_mb;
+
+    if (!Resize(mbsize)) {
+        Free();
+        success = false;
+        tt_mb = 0;
+        AllocTrans(mbsize);
+    }
 }
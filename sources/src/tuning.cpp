@@ -125,7 +125,7 @@ double cEngine::TexelFit(POS *p, int *pv) {
     double sum = 0.0;
     double k_const = 1.250;
     int iteration = 0;
-    Trans.Clear();
+    Trans.Reset();
     ClearAll();
 
     double result = 1;
@@ -24,6 +24,8 @@ If not, see <http://www.gnu.org/licenses/>.
 
 #ifdef USE_THREADS
     #include <thread>
+    #include <deque>
+    #include <algorithm>
     using namespace std::literals::chrono_literals;
 #endif
 
@@ -33,6 +35,242 @@ If not, see <http://www.gnu.org/licenses/>.
     #include <unistd.h>
 #endif
 
+// Commands that are obeyed while a search is running
+
+static bool IsSearchCommand(const char *command) {
+
+    return strcmp(command, "stop") == 0
+        || strcmp(command, "quit") == 0
+        || strcmp(command, "ponderhit") == 0
+        || strcmp(command, "isready") == 0;
+}
+
+static void DoSearchCommand(const char *command) {
+
+    if (strcmp(command, "stop") == 0)
+        Glob.abortSearch = true;
+    else if (strcmp(command, "quit") == 0) {
+#ifndef USE_THREADS
+        exit(0);
+#else
+        Glob.abortSearch = true;
+        Glob.goodbye = true; // will crash if just `exit()`. should wait until threads are terminated
+#endif
+    }
+    else if (strcmp(command, "ponderhit") == 0)
+        Glob.pondering = false;
+    else if (strcmp(command, "isready") == 0)
+        printfUciOut("readyok\n");
+}
+
+#ifdef USE_THREADS
+
+// The timer thread lives as long as the program. It sleeps between
+// searches. During a search it wakes up when the move time runs out,
+// when input arrives or when Stop() is called, and never polls.
+
+class cSearchTimer {
+    std::thread mThread;
+    std::mutex mMutex;
+    std::condition_variable mWake;
+    bool mRunning = false;      // a search is on and should be watched
+    bool mWatching = false;     // the thread is inside its watching loop
+    bool mPoked = false;        // new input is waiting
+    bool mQuit = false;
+
+    static bool Deadline(std::chrono::steady_clock::time_point *when) {
+
+        if (Glob.pondering || Glob.infinite || Glob.isTuning || cEngine::msMoveTime < 0)
+            return false;
+
+        *when = std::chrono::steady_clock::now()
+              + std::chrono::milliseconds(cEngine::msStartTime + cEngine::msMoveTime - GetMS());
+        return true;
+    }
+
+    void Loop() {
+
+        std::unique_lock<std::mutex> lock(mMutex);
+        std::chrono::steady_clock::time_point when;
+
+        for (;;) {
+            mWake.wait(lock, [this] { return mRunning || mQuit; });
+            if (mQuit) return;
+
+            mWatching = true;
+            while (mRunning && Glob.abortSearch == false) {
+                lock.unlock();
+                if (!Glob.isTuning) CheckTimeout();
+                lock.lock();
+
+                if (!mRunning || Glob.abortSearch)
+                    break;
+
+                auto woken = [this] { return !mRunning || mPoked; };
+                if (Deadline(&when))
+                    mWake.wait_until(lock, when, woken);
+                else
+                    mWake.wait(lock, woken);
+                mPoked = false;
+            }
+            mRunning = false;
+            mWatching = false;
+            mWake.notify_all();
+        }
+    }
+
+  public:
+
+    void Start() {
+
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (!mThread.joinable())
+            mThread = std::thread([this] { Loop(); });
+        mRunning = true;
+        mPoked = false;
+        mWake.notify_all();
+    }
+
+    void Stop() {               // returns once the thread has left the search alone
+
+        std::unique_lock<std::mutex> lock(mMutex);
+        mRunning = false;
+        mWake.notify_all();
+        mWake.wait(lock, [this] { return !mWatching; });
+    }
+
+    void Poke() {
+
+        std::lock_guard<std::mutex> lock(mMutex);
+        mPoked = true;
+        mWake.notify_all();
+    }
+
+    ~cSearchTimer() {
+
+        if (!mThread.joinable())
+            return;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mRunning = false;
+            mQuit = true;
+        }
+        mWake.notify_all();
+        mThread.join();
+    }
+};
+
+// Never destroyed: the input thread below may still poke it while exit()
+// runs the static destructors
+
+static cSearchTimer &SearchTimer = *new cSearchTimer;
+
+// Standard input is read by a thread of its own, which queues the lines.
+// Search commands are taken out of the queue as soon as they arrive, the
+// rest waits there for UciLoop(). End of input is queued as "quit".
+
+class cInput {
+    std::thread mThread;
+    std::mutex mMutex;
+    std::condition_variable mWake;
+    std::deque<std::string> mLines;
+
+    void Loop() {
+
+        char line[4096], *ptr;
+
+        for (;;) {
+            const bool eof = fgets(line, sizeof(line), stdin) == NULL;
+
+            if (eof)
+                strcpy(line, "quit");
+            else if ((ptr = strchr(line, '\n')) != NULL)
+                *ptr = '\0';
+
+            printfUciIn("%s\n", line);
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                mLines.push_back(line);
+            }
+            mWake.notify_all();
+            SearchTimer.Poke();
+
+            if (eof) return;
+        }
+    }
+
+    bool HasSearchCommand() const {
+
+        for (const std::string& line : mLines)
+            if (IsSearchCommand(line.c_str()))
+                return true;
+        return false;
+    }
+
+  public:
+
+    void Start() {
+
+        mThread = std::thread([this] { Loop(); });
+        mThread.detach();   // may be blocked in fgets() when we exit
+    }
+
+    void ReadLine(char *str, int n) {
+
+        std::unique_lock<std::mutex> lock(mMutex);
+        mWake.wait(lock, [this] { return !mLines.empty(); });
+
+        strncpy(str, mLines.front().c_str(), n - 1);
+        str[n - 1] = '\0';
+        mLines.pop_front();
+    }
+
+    void DoSearchCommands() {   // obey and remove the queued search commands
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+
+            for (auto line = mLines.begin(); line != mLines.end(); )
+                if (IsSearchCommand(line->c_str())) {
+                    DoSearchCommand(line->c_str());
+                    line = mLines.erase(line);
+                } else
+                    ++line;
+        }
+        mWake.notify_all();
+    }
+
+    // Sleep until there is a search command or a search command has
+    // changed the state, so that the search no longer has to wait.
+
+    void WaitSearchCommand() {
+
+        std::unique_lock<std::mutex> lock(mMutex);
+        mWake.wait(lock, [this] {
+            return HasSearchCommand() || Glob.abortSearch || !(Glob.pondering || Glob.infinite);
+        });
+    }
+};
+
+static cInput &Input = *new cInput;     // outlives the detached input thread
+
+void ReadLine(char *str, int n) {
+
+    Input.ReadLine(str, n);
+}
+
+void HandleSearchInput() {
+
+    Input.DoSearchCommands();
+}
+
+void WaitSearchInput() {
+
+    Input.WaitSearchCommand();
+}
+
+#else
+
 void ReadLine(char *str, int n) {
 
     char *ptr;
@@ -45,6 +283,18 @@ void ReadLine(char *str, int n) {
     printfUciIn("%s\n", str);
 }
 
+void HandleSearchInput() {
+
+    char command[80];
+
+    if (InputAvailable()) {
+        ReadLine(command, sizeof(command));
+        DoSearchCommand(command);
+    }
+}
+
+#endif
+
 const char *ParseToken(const char *string, char *token) {
 
     while (*string == ' ')
@@ -62,6 +312,9 @@ void UciLoop() {
 
     setbuf(stdin, NULL);
     setbuf(stdout, NULL);
+#ifdef USE_THREADS
+    Input.Start();
+#endif
     p->SetPosition(START_POS);
     Trans.AllocTrans(16);
     for (;;) {
@@ -76,6 +329,7 @@ void UciLoop() {
             printfUciOut("id author Pawel Koziol, Bernhard C. Maerz (based on Sungorus 1.4 by Pablo Vazquez)\n");
             PrintOverrides();
             PrintUciOptions();
+            Trans.PrintBacking();
             printfUciOut("uciok\n");
         } else if (strcmp(token, "ucinewgame") == 0) {
             SkipBeginningOfLog = false;
@@ -120,6 +374,38 @@ void UciLoop() {
             EngineSingle.Bench(atoi(token));
 #else
             Engines.front().Bench(atoi(token));
+#endif
+        } else if (strcmp(token, "benchtt") == 0)    {
+            ptr = ParseToken(ptr, token);
+            Trans.Bench(atoi(token));
+        } else if (strcmp(token, "ttstats") == 0)    {
+            Trans.PrintStats();
+        } else if (strcmp(token, "cachestats") == 0) {
+            cEngine::PrintCacheStats();
+        } else if (strcmp(token, "savehash") == 0)   {
+            ptr = ParseToken(ptr, token);
+            Trans.Save(*token ? token : Glob.hashFile.c_str());
+        } else if (strcmp(token, "loadhash") == 0)   {
+            ptr = ParseToken(ptr, token);
+            Glob.shouldLoadHash = false;
+            Trans.Load(*token ? token : Glob.hashFile.c_str());
+#ifdef USE_THREADS
+        } else if (strcmp(token, "benchsmp") == 0)   {
+            ptr = ParseToken(ptr, token);
+            int depth = atoi(token);
+            ptr = ParseToken(ptr, token);
+            BenchSmp(depth, atoi(token));
+        } else if (strcmp(token, "smpstats") == 0)   {
+            sSmpStats sum = cEngine::SumSmpStats();
+            printf("moves marked busy:     %" PRIu64 "\n", sum.marked);
+            printf("searched by two:       %" PRIu64 " (%.2f%%)\n", sum.duplicated,
+                   sum.marked ? 100.0 * sum.duplicated / sum.marked : 0.0);
+            printf("deferred by helpers:   %" PRIu64 "\n", sum.deferred);
+        } else if (strcmp(token, "benchvote") == 0)  {
+            ptr = ParseToken(ptr, token);
+            int threads = atoi(token);
+            ptr = ParseToken(ptr, token);
+            BenchVote(threads, atoi(token));
 #endif
         } else if (strcmp(token, "quit") == 0)       {
             exit(0);
@@ -242,6 +528,84 @@ void cEngine::SetMoveTime(int base, int inc, int movestogo) {
     }
 }
 
+#ifdef USE_THREADS
+
+// The engine that completed the most iterations
+
+static cEngine *DeepestEngine() {
+
+    cEngine *best = &Engines.front();
+
+    for (auto& engine: Engines)
+        if (best->mDpCompleted < engine.mDpCompleted)
+            best = &engine;
+
+    return best;
+}
+
+// Lazy SMP threads often end up with different moves. Every thread votes
+// for its move with a weight that grows with the depth it completed and
+// with its score above the worst one, so a move backed by several deep
+// threads beats one thread that happened to finish an extra iteration.
+// A mate found by any thread is played, the quickest one if there are more.
+
+static bool HasVote(const cEngine &voter) {
+
+    return voter.mDpCompleted && voter.mPvEng[0];
+}
+
+static cEngine *VoteBestEngine() {
+
+    int minScore = INF;
+    const int size = (int)Engines.size();
+    std::vector<int> weight(size), votes(size);
+    std::vector<cEngine *> engines(size);
+    int count = 0;
+
+    for (auto& engine: Engines) {
+        engines[count++] = &engine;
+        if (HasVote(engine))
+            minScore = Min(minScore, engine.mScoreCompleted);
+    }
+
+    for (int i = 0; i < count; i++)
+        weight[i] = HasVote(*engines[i]) ? (engines[i]->mScoreCompleted - minScore + 14) * engines[i]->mDpCompleted : 0;
+
+    for (int i = 0; i < count; i++) {
+        votes[i] = 0;
+        for (int j = 0; j < count; j++)
+            if (engines[j]->mPvEng[0] == engines[i]->mPvEng[0])
+                votes[i] += weight[j];
+    }
+
+    int best = 0;
+
+    for (int i = 1; i < count; i++) {
+        if (!HasVote(*engines[i]))
+            continue;
+
+        if (!HasVote(*engines[best])) {
+            best = i;
+            continue;
+        }
+
+        const int score = engines[i]->mScoreCompleted;
+        const int bestScore = engines[best]->mScoreCompleted;
+
+        if (score > MAX_EVAL || bestScore > MAX_EVAL) {
+            if (score > bestScore)
+                best = i;
+        } else if (votes[i] > votes[best]
+               || (engines[i]->mPvEng[0] == engines[best]->mPvEng[0]
+               &&  engines[i]->mDpCompleted > engines[best]->mDpCompleted))
+            best = i;
+    }
+
+    return HasVote(*engines[best]) ? engines[best] : DeepestEngine();
+}
+
+#endif
+
 void ParseGo(POS *p, const char *ptr) {
 
     if (Glob.personalityB != "") {
@@ -324,12 +688,17 @@ void ParseGo(POS *p, const char *ptr) {
     // set global variables
 
     cEngine::msStartTime = GetMS();
-    Trans.tt_date = (Trans.tt_date + 1) & 255;
-    Glob.nodes = 0;
+    Trans.NewSearch();
+    cEngine::ClearNodes();
     Glob.abortSearch = false;
     Glob.depthReached = 0;
     if (Glob.shouldClear)
         Glob.ClearData(); // options has been changed and old tt scores are no longer reliable
+    if (Glob.shouldLoadHash) { // loaded only now, so that neither ucinewgame nor the above clear it
+        Glob.shouldLoadHash = false;
+        if (Trans.Load(Glob.hashFile.c_str()))
+            Trans.NewSearch();
+    }
     Par.InitAsymmetric(p);
     Glob.finishedDepth = 0;
 
@@ -367,12 +736,14 @@ void ParseGo(POS *p, const char *ptr) {
 
     if (Glob.multiPv > 1) {
 
-        int pv[MAX_PLY];
-
 #ifndef USE_THREADS
+        int pv[MAX_PLY];
         EngineSingle.MultiPv(p, pv);
 #else
-        Engines.front().MultiPv(p, pv);
+        StartEngines(p);    // Engines.front() prints the lines and the best move
+        SearchTimer.Start();
+        WaitEngines();
+        SearchTimer.Stop();
 #endif
 
         if (Glob.goodbye)
@@ -391,93 +762,71 @@ void ParseGo(POS *p, const char *ptr) {
 #else
     Glob.goodbye = false;
 
-	for (int i = 0; i < MAX_THREADS; i++) {
-		tDepth[i] = 0;
-	}
-
-    for (auto& engine: Engines) // mDpCompleted cleared in StartThinkThread();
-        engine.StartThinkThread(p);
-
-    std::thread timer([] {
-        while (Glob.abortSearch == false) {
-
-            // Check for timeout every 1 millisecond. This allows Rodent
-            // to survive extreme time controls, like 1 s + 10 ms
-
-            std::this_thread::sleep_for(1ms);
-            if (!Glob.isTuning) CheckTimeout();
-        }
-    });
+    std::fill(tDepth.begin(), tDepth.end(), 0);
 
-    for (auto& engine: Engines)
-        engine.WaitThinkThread();
+    StartEngines(p);
+    SearchTimer.Start();
+    WaitEngines();
 
-    timer.join();
+    SearchTimer.Stop();
+    cEngine::SumNodes();
 
     if (Glob.goodbye)
         exit(0);
 
-    int *best_pv = NULL;
-	int best_depth = -1;
-
-    for (auto& engine: Engines)
-        if (best_depth < engine.mDpCompleted) {
-            best_depth = engine.mDpCompleted;
-            best_pv = engine.mPvEng;
-        }
-
     Engines.front().ReadyForBestmove();
-    p->ExtractMove(best_pv);
+    p->ExtractMove(VoteBestEngine()->mPvEng);
 #endif
 
     }
 
 }
 
+static const char *benchPositions[] = {
+    "r1bqkbnr/pp1ppppp/2n5/2p5/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq -",       // 1.e4 c5 2.Nf3 Nc6
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -",   // multiple captures
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - -",                              // rook endgame
+    "4rrk1/pp1n3p/3q2pQ/2p1pb2/2PP4/2P3N1/P2B2PP/4RRK1 b - - 7 19",
+    "rq3rk1/ppp2ppp/1bnpb3/3N2B1/3NP3/7P/PPPQ1PP1/2KR3R w - - 7 14",      // knight pseudo-sack
+    "r1bq1r1k/1pp1n1pp/1p1p4/4p2Q/4Pp2/1BNP4/PPP2PPP/3R1RK1 w - - 2 14",  // pawn chain
+    "r3r1k1/2p2ppp/p1p1bn2/8/1q2P3/2NPQN2/PPP3PP/R4RK1 b - - 2 15",
+    "r1bbk1nr/pp3p1p/2n5/1N4p1/2Np1B2/8/PPP2PPP/2KR1B1R w kq - 0 13",
+    "r1bq1rk1/ppp1nppp/4n3/3p3Q/3P4/1BP1B3/PP1N2PP/R4RK1 w - - 1 16",     // attack for pawn
+    "4r1k1/r1q2ppp/ppp2n2/4P3/5Rb1/1N1BQ3/PPP3PP/R5K1 w - - 1 17",        // exchange sack
+    "2rqkb1r/ppp2p2/2npb1p1/1N1Nn2p/2P1PP2/8/PP2B1PP/R1BQK2R b KQ - 0 11",
+    "r1bq1r1k/b1p1npp1/p2p3p/1p6/3PP3/1B2NN2/PP3PPP/R2Q1RK1 w - - 1 16",  // white pawn center
+    "3r1rk1/p5pp/bpp1pp2/8/q1PP1P2/b3P3/P2NQRPP/1R2B1K1 b - - 6 22",
+    "r1q2rk1/2p1bppp/2Pp4/p6b/Q1PNp3/4B3/PP1R1PPP/2K4R w - - 2 18",
+    "4k2r/1pb2ppp/1p2p3/1R1p4/3P4/2r1PN2/P4PPP/1R4K1 b - - 3 22",         // endgame
+    "3q2k1/pb3p1p/4pbp1/2r5/PpN2N2/1P2P2P/5PP1/Q2R2K1 b - - 4 26",        // both queens en prise
+    NULL
+}; // test positions taken from DiscoCheck by Lucas Braesch
+
 void cEngine::Bench(int depth) {
 
     POS p[1];
     int pv[MAX_PLY];
-    const char *test[] = {
-        "r1bqkbnr/pp1ppppp/2n5/2p5/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq -",       // 1.e4 c5 2.Nf3 Nc6
-        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -",   // multiple captures
-        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - -",                              // rook endgame
-        "4rrk1/pp1n3p/3q2pQ/2p1pb2/2PP4/2P3N1/P2B2PP/4RRK1 b - - 7 19",
-        "rq3rk1/ppp2ppp/1bnpb3/3N2B1/3NP3/7P/PPPQ1PP1/2KR3R w - - 7 14",      // knight pseudo-sack
-        "r1bq1r1k/1pp1n1pp/1p1p4/4p2Q/4Pp2/1BNP4/PPP2PPP/3R1RK1 w - - 2 14",  // pawn chain
-        "r3r1k1/2p2ppp/p1p1bn2/8/1q2P3/2NPQN2/PPP3PP/R4RK1 b - - 2 15",
-        "r1bbk1nr/pp3p1p/2n5/1N4p1/2Np1B2/8/PPP2PPP/2KR1B1R w kq - 0 13",
-        "r1bq1rk1/ppp1nppp/4n3/3p3Q/3P4/1BP1B3/PP1N2PP/R4RK1 w - - 1 16",     // attack for pawn
-        "4r1k1/r1q2ppp/ppp2n2/4P3/5Rb1/1N1BQ3/PPP3PP/R5K1 w - - 1 17",        // exchange sack
-        "2rqkb1r/ppp2p2/2npb1p1/1N1Nn2p/2P1PP2/8/PP2B1PP/R1BQK2R b KQ - 0 11",
-        "r1bq1r1k/b1p1npp1/p2p3p/1p6/3PP3/1B2NN2/PP3PPP/R2Q1RK1 w - - 1 16",  // white pawn center
-        "3r1rk1/p5pp/bpp1pp2/8/q1PP1P2/b3P3/P2NQRPP/1R2B1K1 b - - 6 22",
-        "r1q2rk1/2p1bppp/2Pp4/p6b/Q1PNp3/4B3/PP1R1PPP/2K4R w - - 2 18",
-        "4k2r/1pb2ppp/1p2p3/1R1p4/3P4/2r1PN2/P4PPP/1R4K1 b - - 3 22",         // endgame
-        "3q2k1/pb3p1p/4pbp1/2r5/PpN2N2/1P2P2P/5PP1/Q2R2K1 b - - 4 26",        // both queens en prise
-        NULL
-    }; // test positions taken from DiscoCheck by Lucas Braesch
 
     Glob.isBenching = true;
 
     if (depth == 0) depth = 8; // so that you can call bench without parameters
-    Trans.Clear();
+    Trans.Reset();
     ClearAll();
     mDpCompleted = 0; // maybe move to ClearAll()?
     Par.shut_up = true;
 
     printf("Bench test started (depth %d): \n", depth);
 
-    Glob.nodes = 0;
+    ClearNodes();
     Glob.abortSearch = false;
     msStartTime = GetMS();
     msSearchDepth = depth;
 
     // search each position to desired depth
 
-    for (int i = 0; test[i]; ++i) {
-        printf("%s\n", test[i]);
-        p->SetPosition(test[i]);
+    for (int i = 0; benchPositions[i]; ++i) {
+        printf("%s\n", benchPositions[i]);
+        p->SetPosition(benchPositions[i]);
         Par.InitAsymmetric(p);
         Glob.depthReached = 0;
         Iterate(p, pv);
@@ -486,12 +835,185 @@ void cEngine::Bench(int depth) {
     // calculate and print statistics
 
     int end_time = GetMS() - msStartTime;
+    SumNodes();
     unsigned int nps = (unsigned int)((Glob.nodes * 1000) / (end_time + 1));
 
     printf("%" PRIu64 " nodes searched in %d, speed %u nps (Score: %.3f)\n", (U64)Glob.nodes, end_time, nps, (float)nps / 430914.0);
     Glob.isBenching = false;
 }
 
+#ifdef USE_THREADS
+
+// Search one bench position with all engines, the way ParseGo() does
+
+static void BenchSearch(POS *p) {
+
+    Par.InitAsymmetric(p);
+    cEngine::ClearNodes();
+    Glob.abortSearch = false;
+    Glob.depthReached = 0;
+    Glob.finishedDepth = 0;
+    std::fill(tDepth.begin(), tDepth.end(), 0);
+    cEngine::msStartTime = GetMS();
+
+    StartEngines(p);
+    WaitEngines();
+}
+
+// Searches the bench positions with 1, 2, 4... up to maxThreads threads
+// and reports the speed and the time to depth for each thread count, so
+// that SMP scaling (i.e. the cost of sharing the transposition table and
+// the gain from helper threads) can be measured.
+
+void BenchSmp(int depth, int maxThreads) {
+
+    POS p[1];
+    const int oldThreads = Glob.numberOfThreads;
+    const bool oldPrintPv = Glob.printPv;
+    std::vector<int> threadsUsed, timeUsed;
+    std::vector<U64> nodesUsed;
+    std::vector<sSmpStats> smpUsed;
+
+    if (depth == 0) depth = 8;
+    if (maxThreads <= 0) maxThreads = Max((int)std::thread::hardware_concurrency(), 1);
+    if (maxThreads > MaxThreads()) maxThreads = MaxThreads();
+
+    Glob.isBenching = true;
+    Glob.printPv = false;
+    Glob.pondering = false;
+    Glob.infinite = false;
+    Par.shut_up = false;
+    cEngine::msMoveTime = -1;
+    cEngine::msMoveNodes = 0;
+    cEngine::msSearchDepth = depth;
+
+    printf("SMP bench test started (depth %d, up to %d threads): \n", depth, maxThreads);
+
+    for (int threads = 1; ; threads = Min(threads * 2, maxThreads)) {
+
+        Glob.numberOfThreads = threads;
+        ResizeEngines(threads);
+        Glob.ClearData();
+        Trans.Reset();
+
+        U64 nodes = 0;
+        int time = 0;
+        sSmpStats smp = {};
+
+        for (int i = 0; benchPositions[i]; ++i) {
+            p->SetPosition(benchPositions[i]);
+            BenchSearch(p);
+            time += GetMS() - cEngine::msStartTime;
+            nodes += cEngine::SumNodes();
+
+            sSmpStats sum = cEngine::SumSmpStats();
+            smp.marked += sum.marked;
+            smp.duplicated += sum.duplicated;
+            smp.deferred += sum.deferred;
+        }
+
+        threadsUsed.push_back(threads);
+        nodesUsed.push_back(nodes);
+        timeUsed.push_back(time);
+        smpUsed.push_back(smp);
+
+        if (threads == maxThreads) break;
+    }
+
+    // "speedup" compares nodes per second, "ttd" compares the time to
+    // reach the same depth, which is what the extra threads are for.
+    // "dup%" is the share of moves that another thread was already
+    // searching, "deferred" counts the moves helpers put off for that.
+
+    printf("\n threads        nodes     time          nps  speedup      ttd     dup%%   deferred\n");
+    for (size_t i = 0; i < threadsUsed.size(); i++) {
+        U64 nps = (nodesUsed[i] * 1000) / (timeUsed[i] + 1);
+        U64 base = (nodesUsed[0] * 1000) / (timeUsed[0] + 1);
+        printf("%8d %12" PRIu64 " %8d %12" PRIu64 " %8.2f %8.2f %8.2f %10" PRIu64 "\n",
+               threadsUsed[i], nodesUsed[i], timeUsed[i], nps, (double)nps / (double)(base + 1),
+               (double)(timeUsed[0] + 1) / (double)(timeUsed[i] + 1),
+               smpUsed[i].marked ? 100.0 * smpUsed[i].duplicated / smpUsed[i].marked : 0.0, smpUsed[i].deferred);
+    }
+
+    // restore previous settings
+
+    Glob.numberOfThreads = oldThreads;
+    ResizeEngines(oldThreads);
+    Glob.printPv = oldPrintPv;
+    Glob.isBenching = false;
+}
+
+// Searches every bench position with `threads` threads and a node limit,
+// then once more with one thread and eight times the nodes as a referee.
+// Reports how often the voted move and the move of the deepest thread
+// agree with the referee, so that the move choice of Lazy SMP can be
+// compared at a fixed amount of work.
+
+void BenchVote(int threads, int nodes) {
+
+    POS p[1];
+    const int oldThreads = Glob.numberOfThreads;
+    const bool oldPrintPv = Glob.printPv;
+    int positions = 0, voteAgrees = 0, deepAgrees = 0, differ = 0;
+
+    if (threads <= 0) threads = 4;
+    if (threads > MaxThreads()) threads = MaxThreads();
+    if (nodes <= 0) nodes = 200000;
+
+    Glob.isBenching = true;
+    Glob.printPv = false;
+    Glob.pondering = false;
+    Glob.infinite = false;
+    Par.shut_up = false;
+    cEngine::msMoveTime = -1;
+    cEngine::msSearchDepth = 64;
+
+    printf("Voting bench started (%d threads, %d nodes, referee 1 thread, %d nodes): \n", threads, nodes, nodes * 8);
+    printf("\n position  voted  deepest  referee\n");
+
+    for (int i = 0; benchPositions[i]; ++i) {
+        p->SetPosition(benchPositions[i]);
+
+        Glob.numberOfThreads = threads;
+        ResizeEngines(threads);
+        Glob.ClearData();
+        Trans.Reset();
+        cEngine::msMoveNodes = nodes;
+        BenchSearch(p);
+        const int voted = VoteBestEngine()->mPvEng[0];
+        const int deepest = DeepestEngine()->mPvEng[0];
+
+        Glob.numberOfThreads = 1;
+        ResizeEngines(1);
+        Glob.ClearData();
+        Trans.Reset();
+        cEngine::msMoveNodes = nodes * 8;
+        BenchSearch(p);
+        const int referee = Engines.front().mPvEng[0];
+
+        printf("%9d  %5s  %7s  %7s\n", i + 1,
+               MoveToStr(voted).c_str(), MoveToStr(deepest).c_str(), MoveToStr(referee).c_str());
+
+        positions++;
+        voteAgrees += voted == referee;
+        deepAgrees += deepest == referee;
+        differ += voted != deepest;
+    }
+
+    printf("\nvoted move agrees with referee:   %d of %d\n", voteAgrees, positions);
+    printf("deepest move agrees with referee: %d of %d\n", deepAgrees, positions);
+    printf("voted and deepest moves differ:   %d of %d\n", differ, positions);
+
+    // restore previous settings
+
+    cEngine::msMoveNodes = 0;
+    Glob.numberOfThreads = oldThreads;
+    ResizeEngines(oldThreads);
+    Glob.printPv = oldPrintPv;
+    Glob.isBenching = false;
+}
+#endif
+
 void POS::PrintBoard() const {
 
     static const char piece_name[] = {'P', 'p', 'N', 'n', 'B', 'b', 'R', 'r', 'Q', 'q', 'K', 'k', '.' };
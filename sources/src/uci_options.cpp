@@ -72,6 +72,13 @@ void PrintUciOptions() {
 
 	printfUciOut("option name Clear Hash type button\n");
     printfUciOut("option name Hash type spin default 16 min 1 max %d\n", max_tt_size_mb);
+    printfUciOut("option name EvalCacheKB type spin default %d min 16 max 1048576\n", Glob.evalCacheKb);
+    printfUciOut("option name EvalCacheShared type check default %s\n", Glob.shareEvalCache ? "true" : "false");
+    printfUciOut("option name PawnCacheKB type spin default %d min 16 max 1048576\n", Glob.pawnCacheKb);
+    printfUciOut("option name HashFile type string default %s\n", Glob.hashFile != "" ? Glob.hashFile.c_str() : "<empty>");
+#if !defined(_WIN32)
+    printfUciOut("option name HashShare type string default <empty>\n");
+#endif
 
     if (LogFileWStr != L"")
         printfUciOut("option name LogFile type string default %s\n", WStr2Str(LogFileWStr).c_str());
@@ -81,8 +88,13 @@ void PrintUciOptions() {
 #endif
 
 #ifdef USE_THREADS
-	if (Glob.threadOverride == 0)
-    printfUciOut("option name Threads type spin default %d min 1 max %d\n", Glob.numberOfThreads, MAX_THREADS);
+    if (Glob.threadOverride == 0) {
+        printfUciOut("option name Threads type spin default %d min 1 max %d\n", Glob.numberOfThreads, MaxThreads());
+    }
+    printfUciOut("option name ThreadAffinity type check default %s\n", Glob.pinThreads ? "true" : "false");
+    printfUciOut("option name SmpProfiles type check default %s\n", Glob.useSmpProfiles ? "true" : "false");
+    printfUciOut("option name SmpDefer type check default %s\n", Glob.useSmpDefer ? "true" : "false");
+    printfUciOut("option name SmpMode type combo default %s var Lazy var YBWC\n", Glob.smpMode == SMP_YBWC ? "YBWC" : "Lazy");
 #endif
     printfUciOut("option name MultiPV type spin default %d min 1 max %d\n", Glob.multiPv, MAX_PV);
 	printfUciOut("option name TimeBuffer type spin default %d min 0 max 1000\n", Glob.timeBuffer);
@@ -251,17 +263,42 @@ void ParseSetoption(const char *ptr) {
 
     if (strcmp(name, "hash") == 0)                                           {
         Trans.AllocTrans(atoi(value));
+    } else if (strcmp(name, "evalcachekb") == 0)                             {
+        Glob.evalCacheKb = Max(16, Min(atoi(value), 1048576));
+        cEngine::ResizeAllCaches();
+    } else if (strcmp(name, "evalcacheshared") == 0)                         {
+        valuebool(Glob.shareEvalCache, value);
+        cEngine::ResizeAllCaches();
+    } else if (strcmp(name, "pawncachekb") == 0)                             {
+        Glob.pawnCacheKb = Max(16, Min(atoi(value), 1048576));
+        cEngine::ResizeAllCaches();
 #ifdef USE_THREADS
     } else if (strcmp(name, "threads") == 0 && Glob.threadOverride == 0)     {
         Glob.numberOfThreads = (atoi(value));
-        if (Glob.numberOfThreads > MAX_THREADS) Glob.numberOfThreads = MAX_THREADS;
-
-        if (Glob.numberOfThreads != (int)Engines.size()) {
-            Engines.clear();
-            for (int i = 0; i < Glob.numberOfThreads; i++)
-                Engines.emplace_back(i);
-        }
+        if (Glob.numberOfThreads > MaxThreads()) Glob.numberOfThreads = MaxThreads();
+
+        ResizeEngines(Glob.numberOfThreads);
+        if (Glob.pinThreads) PlaceEngines(true);
+    } else if (strcmp(name, "threadaffinity") == 0)                          {
+        valuebool(Glob.pinThreads, value);
+        PlaceEngines(true);
+    } else if (strcmp(name, "smpprofiles") == 0)                             {
+        valuebool(Glob.useSmpProfiles, value);
+    } else if (strcmp(name, "smpdefer") == 0)                                {
+        valuebool(Glob.useSmpDefer, value);
+    } else if (strcmp(name, "smpmode") == 0)                                 {
+        if (strcmp(value, "YBWC") == 0 || strcmp(value, "ybwc") == 0)
+            Glob.smpMode = SMP_YBWC;
+        else
+            Glob.smpMode = SMP_LAZY;
 #endif
+    } else if (strcmp(name, "hashfile") == 0)                                {
+        Glob.hashFile = strcmp(value, "<empty>") == 0 ? "" : value;
+        Glob.shouldLoadHash = Glob.hashFile != "";
+    } else if (strcmp(name, "hashshare") == 0)                               {
+        Trans.Unshare();
+        if (strcmp(value, "<empty>") != 0 && *value)
+            Trans.Share(value);
     } else if (strcmp(name, "clear hash") == 0)                              {
         Trans.Clear();
     } else if (strcmp(name, "multipv") == 0)                                 {
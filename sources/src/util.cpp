@@ -288,7 +288,11 @@ void cEngine::ReadyForBestmove() {
 
 		// Continue only with stop, quit or (if ponder-mode) ponderhit
 		while ((Glob.pondering || Glob.infinite) && !Glob.abortSearch) {
+#ifdef USE_THREADS
+			WaitSearchInput();
+#else
 			WasteTime(10);
+#endif
 			CheckTimeout();
 		}
     }